@@ -98,10 +98,32 @@ class Cartridge
 public:
 	virtual ~Cartridge() noexcept = default;
 
+	// deep copy of the cartridge, rom, ram and banking state
+	virtual std::unique_ptr<Cartridge> clone() const = 0;
+	// copies other into this cartridge when both are the same type, reusing
+	// the memory already allocated. Returns false if the types differ
+	virtual bool assign(const Cartridge &other) = 0;
+
 	virtual uint8_t read_byte(uint16_t addr) = 0;
 	virtual void write_byte(uint16_t addr, uint8_t value) = 0;
+
+	// returns the len bytes currently mapped at addr if they are plain rom,
+	// nullptr otherwise. Lets callers block copy instead of reading byte by byte
+	virtual const uint8_t *read_ptr(uint16_t addr, uint16_t len) { return nullptr; }
+
+	// rom bank mapped at 0x4000-0x7FFF, for traces and debugging
+	virtual uint16_t current_rom_bank() const { return 1; }
 };
 
+// a rom's contents, never written once loaded. Cartridges made from the same
+// image share it, so copies and snapshots of a system only copy banking state
+// and ram
+using RomImage = std::shared_ptr<const std::vector<uint8_t>>;
+
+// reads a rom from disk, nullptr if it can't be opened
+RomImage load_rom_image(const std::string &filename);
+// the cartridge the rom's header asks for
+std::unique_ptr<Cartridge> make_cartridge(RomImage rom);
 std::unique_ptr<Cartridge> system_load_rom(const std::string &filename);
 
 CartridgeSettings parse_header(const std::vector<uint8_t> &data);
@@ -1,19 +1,98 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <concepts>
 #include <cstdint>
-#include <memory>
+#include <limits>
+#include "InterruptObserver.h"
 #include "MemoryBus.h"
 
+class TraceWriter;
+
+// the ALU operation that last set the flags, if they are still lazy
+enum class FlagOp : uint8_t {
+	NONE,	// flags are stored as they are
+	ADD,	// ADD/ADC
+	SUB,	// SUB/SBC/CP
+	INC,
+	DEC,
+	AND,
+	OR,		// OR/XOR
+};
+
+// Z/N/H/C. ALU instructions only record their operands and result, each
+// flag is worked out when something reads it, which usually never happens
+// before the next ALU instruction overwrites them. Setting a single flag
+// materializes the rest first
 struct Flag {
-	uint8_t C : 1;
-	uint8_t H : 1;
-	uint8_t N : 1;
-	uint8_t Z : 1;
-	uint8_t pad : 4;
-
-	void from_byte(uint8_t byte);
-	uint8_t to_byte();
+	bool z() const {
+		return m_op == FlagOp::NONE ? (m_bits & 0x80) != 0 : m_result == 0;
+	}
+	bool n() const {
+		switch (m_op) {
+		case FlagOp::NONE: return (m_bits & 0x40) != 0;
+		case FlagOp::SUB: case FlagOp::DEC: return true;
+		default: return false;
+		}
+	}
+	bool h() const {
+		switch (m_op) {
+		case FlagOp::NONE: return (m_bits & 0x20) != 0;
+		case FlagOp::ADD: return (m_a & 0x0F) + (m_b & 0x0F) + m_carry > 0x0F;
+		case FlagOp::SUB: return (m_a & 0x0F) < (m_b & 0x0F) + m_carry;
+		case FlagOp::INC: return (m_a & 0x0F) == 0x0F;
+		case FlagOp::DEC: return (m_a & 0x0F) == 0x00;
+		case FlagOp::AND: return true;
+		default: return false;
+		}
+	}
+	bool c() const {
+		switch (m_op) {
+		case FlagOp::NONE: return (m_bits & 0x10) != 0;
+		case FlagOp::ADD: return m_a + m_b + m_carry > 0xFF;
+		case FlagOp::SUB: return m_b + m_carry > m_a;
+		case FlagOp::INC: case FlagOp::DEC: return m_carry;
+		default: return false;
+		}
+	}
+
+	// record an 8 bit ALU op. carry is the carry/borrow in for ADD/SUB and
+	// the C flag INC/DEC leave alone
+	void set_lazy(FlagOp op, uint8_t a, uint8_t b, uint8_t result, uint8_t carry = 0) {
+		m_op = op;
+		m_a = a;
+		m_b = b;
+		m_result = result;
+		m_carry = carry;
+	}
+
+	void set_z(bool set) { set_bit(0x80, set); }
+	void set_n(bool set) { set_bit(0x40, set); }
+	void set_h(bool set) { set_bit(0x20, set); }
+	void set_c(bool set) { set_bit(0x10, set); }
+
+	void from_byte(uint8_t byte) {
+		m_op = FlagOp::NONE;
+		m_bits = byte & 0xF0;
+	}
+	uint8_t to_byte() const {
+		return (z() << 7) | (n() << 6) | (h() << 5) | (c() << 4);
+	}
+
+private:
+	void set_bit(uint8_t mask, bool set) {
+		if (m_op != FlagOp::NONE) {
+			from_byte(to_byte());
+		}
+		m_bits = set ? (m_bits | mask) : (m_bits & ~mask);
+	}
+
+	FlagOp m_op{FlagOp::NONE};
+	uint8_t m_a{0};
+	uint8_t m_b{0};
+	uint8_t m_carry{0};
+	uint8_t m_result{0};
+	uint8_t m_bits{0};
 };
 
 enum RegisterName8Bit : uint8_t {
@@ -24,31 +103,82 @@ enum RegisterName16Bit : uint8_t {
 	BC, DE, HL, SP, AF, PC
 };
 
-class Cpu {
+// anything the cpu can fetch from and load/store to. Extras such as
+// cycles_until_interrupt() are picked up when a bus provides them
+template <typename Bus>
+concept CpuBus = requires(Bus &bus, uint16_t addr, uint8_t value, uint16_t word) {
+	{ bus.read_byte(addr) } -> std::convertible_to<uint8_t>;
+	{ bus.read_word(addr) } -> std::convertible_to<uint16_t>;
+	bus.write_byte(addr, value);
+	bus.write_word(addr, word);
+};
+
+template <CpuBus Bus>
+class BasicCpu {
 public:
-	void connect_bus(std::shared_ptr<MemoryBus> bus);
-	int step(int cycles);
+	void connect_bus(Bus *bus);
+	// without an observer, eg. on a FlatBus, no interrupt is ever pending
+	void connect_interrupt_observer(InterruptObserver *observer);
+	// runs at least cycles, returns the cycles taken. Halts and skipped
+	// loops stop at max_cycles, a single instruction may still end past it
+	int step(int cycles, int max_cycles = std::numeric_limits<int>::max());
 	void reset();
 	bool is_halted() { return m_halted; }
+	void set_halted(bool halted) { m_halted = halted; }
+	// interrupt master enable, part of the state single step tests set and check
+	bool ime() const { return IME; }
+	void set_ime(bool enabled) { IME = enabled; }
+
+	// idle loop skipping, on by default, some roms may need it turned off
+	void set_idle_skip(bool enabled) { m_idle_skip = enabled; }
+	uint64_t idle_loops_skipped() const { return m_idle_loops_skipped; }
+	uint64_t idle_cycles_skipped() const { return m_idle_cycles_skipped; }
+
+	// record every instruction into trace until detached with nullptr. Idle
+	// and copy loops run instruction by instruction while a trace is attached
+	void attach_trace(TraceWriter *trace) { m_trace = trace; }
+	TraceWriter *trace() const { return m_trace; }
+	// cycles run since reset
+	uint64_t cycles() const { return m_cycles; }
+	// set once LD B,B has run, test roms use it as a breakpoint
+	bool debug_break() const { return m_debug_break; }
+	void clear_debug_break() { m_debug_break = false; }
 
 	// read and write functions for registers
 	uint8_t read_byte(RegisterName8Bit reg);
 	void write_byte(RegisterName8Bit reg, uint8_t value);
 	uint16_t read_word(RegisterName16Bit reg);
 	void write_word(RegisterName16Bit reg, uint16_t value);
-	friend void debug_print(Cpu &cpu);
+	template <CpuBus B>
+	friend void debug_print(BasicCpu<B> &cpu);
 
 private:
 
 	//--------------------
 	// member functions
 	//--------------------
-	void fetch();
-	int decode();
+	// fetch the opcode at PC and run its handler, returns the cycles taken
 	int execute();
-
-	int handle_opcode();
-	int handle_cb_prefix();
+	// write the state before the current instruction to m_trace
+	void trace_instruction();
+	bool interrupt_pending() const { return m_int_obs != nullptr && m_int_obs->pending(); }
+
+	// one handler per opcode, generated from the opcode byte so register
+	// operands, bit numbers and conditions are compile time constants
+	using OpcodeHandler = int (BasicCpu::*)();
+	template <uint8_t OP>
+	int execute_opcode();
+	template <uint8_t OP>
+	int execute_cb_opcode();
+
+	// r8 operand encoding, 6 is (HL)
+	template <uint8_t R>
+	uint8_t read_operand();
+	template <uint8_t R>
+	void write_operand(uint8_t value);
+	// cc encoding NZ, Z, NC, C
+	template <uint8_t CC>
+	bool condition();
 
 	// common Opcodes
 	void opcode_push(RegisterName16Bit reg);
@@ -67,6 +197,11 @@ private:
 	// interrupt service routine
 	int service_interrupt();
 
+	// fast forward a register polling loop, returns the cycles skipped
+	int skip_idle_loop(int cycles_taken, int max_cycles);
+	// run a memcpy/memset style loop in one go, returns the cycles it took
+	int run_bulk_loop(int cycles_taken, int max_cycles);
+
 	// flag setting operations
 	void set_flag_c(bool set);
 	void set_flag_h(bool set);
@@ -82,23 +217,30 @@ private:
 	uint16_t m_PC;
 
 	uint8_t m_opcode;
-	bool m_is_cb;
 
-	// useful things for executing instructions
-	RegisterName8Bit m_r1;
-	RegisterName8Bit m_r2;
-	RegisterName16Bit m_r16;
-	uint8_t imm_u8;
-	uint16_t imm_u16;
+	bool m_halted{false};
+	bool IME{false};
+
+	bool m_idle_skip{true};
+	uint64_t m_idle_loops_skipped{0};
+	uint64_t m_idle_cycles_skipped{0};
 
-	bool m_halted;
-	bool IME;
-	uint8_t ei_delay;
-	uint8_t ime_enable;
+	TraceWriter *m_trace{nullptr};
+	uint64_t m_cycles{0};
+	bool m_debug_break{false};
+	// cycle the current instruction started on, for traces
+	uint64_t m_instruction_cycle{0};
 
 	// Bus connection
-	std::shared_ptr<MemoryBus> m_bus;
+	Bus *m_bus{nullptr};
+	InterruptObserver *m_int_obs{nullptr};
 };
 
+template <CpuBus Bus>
+void debug_print(BasicCpu<Bus> &cpu);
+
+// the emulator's cpu, FlatBus and TraceBus instantiations exist for testing
+using Cpu = BasicCpu<MemoryBus>;
+
 
 #endif
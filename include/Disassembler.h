@@ -0,0 +1,16 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// longest text disassemble() writes, including the terminator
+constexpr size_t DISASSEMBLY_MAX = 24;
+
+// Formats the instruction in bytes (up to 3 of them, fetched from pc) into
+// out, e.g. "LD A,(FF00+$44)" or "JR NZ,$0150". out is always terminated
+// and truncated to size. Nothing is allocated so it is cheap enough to run
+// on every step while tracing. Returns the instruction length in bytes
+int disassemble(const uint8_t *bytes, uint16_t pc, char *out, size_t size);
+
+#endif
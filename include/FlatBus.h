@@ -0,0 +1,30 @@
+#ifndef FLAT_BUS_H
+#define FLAT_BUS_H
+
+#include <array>
+#include <cstdint>
+
+/*
+ * FlatBus
+ * 64KB of plain ram with no mapping or IO at all. Enough to run the cpu on
+ * its own, eg. for single step instruction tests or benchmarks
+ */
+class FlatBus {
+public:
+	void reset() { m_memory.fill(0); }
+
+	uint8_t read_byte(uint16_t addr) const { return m_memory[addr]; }
+	uint16_t read_word(uint16_t addr) const {
+		return m_memory[addr] | (m_memory[static_cast<uint16_t>(addr + 1)] << 8);
+	}
+	void write_byte(uint16_t addr, uint8_t value) { m_memory[addr] = value; }
+	void write_word(uint16_t addr, uint16_t value) {
+		m_memory[addr] = value & 0xFF;
+		m_memory[static_cast<uint16_t>(addr + 1)] = value >> 8;
+	}
+
+private:
+	std::array<uint8_t, 0x10000> m_memory{};
+};
+
+#endif
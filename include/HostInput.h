@@ -0,0 +1,44 @@
+#ifndef HOST_INPUT_H
+#define HOST_INPUT_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "JoyPad.h"
+
+/*
+ * HostInput
+ * The buttons the player is holding right now, in the JoyPad::buttons()
+ * layout. The frontend writes it, from its own thread if it has one, and a
+ * connected JoyPad samples it the first time the game reads JOYP in a frame
+ * so the game sees the latest input rather than whatever was held when the
+ * frame started. A frontend that handles events on the emulation thread
+ * sets a poll callback, it is called right before each sample.
+ */
+class HostInput {
+public:
+    using PollCallback = void (*)(void *ctx);
+
+    void press(JoyPadInput input) { m_buttons.fetch_or(bit(input), std::memory_order_release); }
+    void release(JoyPadInput input) { m_buttons.fetch_and(~bit(input), std::memory_order_release); }
+    uint8_t buttons() const { return m_buttons.load(std::memory_order_acquire); }
+
+    void set_poll_callback(PollCallback poll, void *ctx) {
+        m_poll = poll;
+        m_poll_ctx = ctx;
+    }
+    // poll the frontend then return the buttons
+    uint8_t sample() {
+        if (m_poll != nullptr) { m_poll(m_poll_ctx); }
+        return buttons();
+    }
+
+private:
+    static uint8_t bit(JoyPadInput input) { return 1 << static_cast<int>(input); }
+
+    std::atomic<uint8_t> m_buttons{0};
+    PollCallback m_poll{nullptr};
+    void *m_poll_ctx{nullptr};
+};
+
+#endif
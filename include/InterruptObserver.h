@@ -1,8 +1,12 @@
 #ifndef INTERRUPT_OBSERVER_H
 #define INTERRUPT_OBSERVER_H
 
+#include <bit>
+#include <cstdint>
 #include <memory>
 
+class MemoryBus;
+
 // ordered highest priority to lowest
 enum class InterruptSource {
     VBLANK,
@@ -24,12 +28,25 @@ class InterruptObserver {
 public:
     void reset();
     void schedule_interrupt(InterruptSource src);
+    // IF lives in the IO area, IE at 0xFFFF is handled by the bus directly
+    void register_io_handlers(MemoryBus &bus);
     uint8_t read_byte(uint16_t addr);
     void write_byte(uint16_t addr, uint8_t val);
 
+    // IE & IF, kept up to date on every change so the cpu only checks one byte
+    uint8_t pending() const { return m_pending; }
+    // highest priority pending interrupt, only valid when pending() != 0
+    InterruptSource next_pending() const {
+        return static_cast<InterruptSource>(std::countr_zero(m_pending));
+    }
+    void acknowledge(InterruptSource src);
+
 private:
+    void update_pending() { m_pending = m_ie & m_if & 0x1F; }
+
     uint8_t m_if{0xE1};
     uint8_t m_ie{0x00};
+    uint8_t m_pending{0x00};
 };
 
 
@@ -0,0 +1,30 @@
+#ifndef IO_HANDLER_H
+#define IO_HANDLER_H
+
+#include <cstdint>
+
+// number of registers in the IO area 0xFF00 - 0xFF7F
+constexpr int IO_REGISTER_COUNT = 0x80;
+
+/*
+ * IoHandler
+ * Read and write callbacks for one IO register. Components register these
+ * with the MemoryBus when they are connected, ctx is handed back on every
+ * call and usually points at the component or the register itself.
+ */
+struct IoHandler {
+    uint8_t (*read)(void *ctx, uint16_t addr);
+    void (*write)(void *ctx, uint16_t addr, uint8_t value);
+    void *ctx;
+};
+
+// handlers for registers that are a plain byte, ctx points at the byte
+inline uint8_t io_read_byte(void *ctx, uint16_t) { return *static_cast<uint8_t *>(ctx); }
+inline void io_write_byte(void *ctx, uint16_t, uint8_t value) { *static_cast<uint8_t *>(ctx) = value; }
+inline IoHandler io_plain_register(uint8_t *reg) { return IoHandler{io_read_byte, io_write_byte, reg}; }
+
+// unmapped / stubbed registers
+inline uint8_t io_read_open_bus(void *, uint16_t) { return 0xFF; }
+inline void io_write_ignore(void *, uint16_t, uint8_t) {}
+
+#endif
@@ -4,6 +4,9 @@
 #include <memory>
 #include "InterruptObserver.h"
 
+class HostInput;
+class MemoryBus;
+
 enum class JoyPadInput {
     DOWN,
     UP,
@@ -21,20 +24,36 @@ constexpr int JOYP_ADDR = 0xFF00;
 class JoyPad {
 public:
     void reset();
-    void connect_interrupt_observer(std::shared_ptr<InterruptObserver> obs) { m_int_obs = obs; }
+    void connect_interrupt_observer(InterruptObserver *obs) { m_int_obs = obs; }
+    void register_io_handlers(MemoryBus &bus);
     void handle_press(JoyPadInput input);
     void handle_release(JoyPadInput input);
+    // every button as one byte, bit n set while JoyPadInput n is held.
+    // set_buttons presses and releases whatever differs and leaves the
+    // group the game selected in JOYP alone
+    uint8_t buttons() const;
+    void set_buttons(uint8_t pressed);
+
+    // sample host's buttons on the first JOYP read after each start_frame(),
+    // nullptr goes back to buttons set by hand
+    void connect_host_input(HostInput *host) {
+        m_host = host;
+        m_poll_pending = m_poll_pending && host != nullptr;
+    }
+    HostInput *host_input() const { return m_host; }
+    void start_frame();
 
     uint8_t read_byte();
     void write_byte(uint8_t val);
 
 private:
-    void select_dir();
-    void select_action();
+    void poll_host();
     uint8_t m_joyp = 0xCF;
     uint8_t m_dir_button = 0x0F;
     uint8_t m_action_button = 0x0F;
-    std::shared_ptr<InterruptObserver> m_int_obs;
+    InterruptObserver *m_int_obs{nullptr};
+    HostInput *m_host{nullptr};
+    bool m_poll_pending{false};
 };
 
 #endif
@@ -0,0 +1,57 @@
+#ifndef LINK_CABLE_H
+#define LINK_CABLE_H
+
+#include <cstdint>
+#include "Serial.h"
+
+struct System;
+
+// longest the two sides run apart, a transfer takes at least this long so
+// one started inside a slice can't complete before the slice ends
+constexpr int LINK_MAX_SLICE = SERIAL_CYCLES_PER_BYTE;
+
+/*
+ * LinkCable
+ * Plugs the serial ports of two Systems into each other and runs them in
+ * lockstep. Each side runs on its own for up to LINK_MAX_SLICE cycles, the
+ * slice is cut short so it ends exactly where a transfer on the internal
+ * clock completes. The side on the external clock runs up to that cycle
+ * first, then the driving side completes the transfer and both bytes are
+ * swapped. Reset both systems before connecting them.
+ */
+class LinkCable {
+public:
+    LinkCable(System &left, System &right);
+    LinkCable(const LinkCable &) = delete;
+    LinkCable &operator=(const LinkCable &) = delete;
+    // unplugs both sides
+    ~LinkCable();
+
+    // run both sides for a frame's worth of cycles, returns true when
+    // either of them finished a frame
+    bool run_frame();
+    // run both sides for cycles, returns true when either finished a frame
+    bool run(int cycles);
+    // cycles run since connecting
+    uint64_t cycles() const { return m_cycle; }
+    // after both systems were restored from a snapshot taken at cycle
+    void set_cycles(uint64_t cycle) { m_cycle = cycle; }
+
+private:
+    // one plug, swaps the outgoing byte for the other side's
+    struct End : SerialSink {
+        LinkCable *cable{nullptr};
+        int side{0};
+        uint8_t transfer(uint8_t out) override;
+    };
+
+    // cycles run by side since connecting
+    uint64_t side_cycles(int side) const;
+
+    System *m_systems[2];
+    End m_ends[2];
+    uint64_t m_base[2];
+    uint64_t m_cycle{0};
+};
+
+#endif
@@ -7,14 +7,23 @@
 class Mbc0 : public Cartridge
 {
 public:
-	Mbc0(std::vector<uint8_t> rom) : rom_data{ rom } {}
+	Mbc0(RomImage rom) : rom_data{ std::move(rom) }, ram_data(0x2000, 0) {}
 	virtual	~Mbc0() noexcept override = default;
+	virtual std::unique_ptr<Cartridge> clone() const override { return std::make_unique<Mbc0>(*this); }
+	virtual bool assign(const Cartridge &other) override {
+		auto *same = dynamic_cast<const Mbc0 *>(&other);
+		if (same != nullptr) { *this = *same; }
+		return same != nullptr;
+	}
 
 	virtual uint8_t read_byte(uint16_t addr) override;
 	virtual void write_byte(uint16_t addr, uint8_t value) override;
+	virtual const uint8_t *read_ptr(uint16_t addr, uint16_t len) override;
 
 private:
-	std::vector<uint8_t> rom_data;
+	RomImage rom_data;
+	// 0xA000-0xBFFF, plain ram without banking
+	std::vector<uint8_t> ram_data;
 };
 
 #endif
\ No newline at end of file
@@ -4,16 +4,26 @@
 
 class Mbc1 : public Cartridge {
 public:
-	Mbc1(std::vector<uint8_t> data);
+	Mbc1(RomImage data);
 	virtual ~Mbc1() noexcept override = default;
+	virtual std::unique_ptr<Cartridge> clone() const override { return std::make_unique<Mbc1>(*this); }
+	virtual bool assign(const Cartridge &other) override {
+		auto *same = dynamic_cast<const Mbc1 *>(&other);
+		if (same != nullptr) { *this = *same; }
+		return same != nullptr;
+	}
 	virtual uint8_t read_byte(uint16_t addr) override;
 	virtual void write_byte(uint16_t addr, uint8_t value) override;
+	virtual const uint8_t *read_ptr(uint16_t addr, uint16_t len) override;
+	virtual uint16_t current_rom_bank() const override { return rom_bank_sel; }
 
 private:
+	size_t rom_offset(uint16_t addr);
+
 	uint8_t rom_bank_sel{};
 	uint8_t ram_bank_sel{};
 	bool ram_enabled{};
-	std::vector<uint8_t> rom_data{};
+	RomImage rom_data{};
 	std::vector<uint8_t> ram_data{};
 };
 
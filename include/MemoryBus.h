@@ -2,10 +2,13 @@
 #define _MemoryBus_H_
 
 #include <array>
+#include <cstdlib>
 #include "Cartridge.h"
 #include "InterruptObserver.h"
+#include "IoHandler.h"
 #include "JoyPad.h"
 #include "Ppu.h"
+#include "Serial.h"
 #include "Timer.h"
 
 // constant ranges
@@ -29,43 +32,158 @@ constexpr int HRAM_BASE = 0xFF80;
 constexpr int HRAM_END	= 0xFFFE;
 
 // IO Space
-// Serial
-constexpr int SB_ADDR = 0xFF01;
-constexpr int SC_ADDR = 0xFF02;
+// CGB speed switch
+constexpr int KEY1_ADDR = 0xFF4D;
 // Skipping sound registers - TODO
 
 class MemoryBus {
 public:
 	MemoryBus();
+	// copies memory and clones the cartridge. Components keep pointing at the
+	// originals and their IO handlers are not copied, connect them again
+	MemoryBus(const MemoryBus &other);
+	MemoryBus &operator=(const MemoryBus &other);
 	~MemoryBus() = default;
 	void reset();
 	void load_cart(std::unique_ptr<Cartridge> c);
-	void connect_interrupt_observer(std::shared_ptr<InterruptObserver> observer);
-	void connect_joypad(std::shared_ptr<JoyPad> joypad);
-	void connect_ppu(std::shared_ptr<Ppu> ppu);
-	void connect_timer(std::shared_ptr<Timer> timer);
+	void connect_interrupt_observer(InterruptObserver *observer);
+	void connect_joypad(JoyPad *joypad);
+	void connect_ppu(Ppu *ppu);
+	void connect_serial(Serial *serial);
+	void connect_timer(Timer *timer);
+	// claim the IO register at addr, components call this when they are connected
+	void register_io_handler(uint16_t addr, IoHandler handler);
 
 	uint8_t read_byte(uint16_t addr);
 	uint16_t read_word(uint16_t addr);
 	void write_byte(uint16_t addr, uint8_t value);
 	void write_word(uint16_t addr, uint16_t value);
 
+	// cycles until the ppu, timer or serial port next requests an interrupt
+	int cycles_until_interrupt();
+	// cycles until the io register at addr changes on its own,
+	// 0 if it isn't one we can predict
+	int cycles_until_change(uint16_t addr);
+
+	// direct access to len bytes at addr when they are plain rom/ram, nullptr otherwise
+	const uint8_t *read_ptr(uint16_t addr, uint16_t len);
+	// same for writes, only plain ram qualifies
+	uint8_t *write_ptr(uint16_t addr, uint16_t len);
+
+	// the memory behind 0xC000-0xDFFF and 0xFF80-0xFFFE. The buffers live as
+	// long as the bus, restoring a snapshot copies into them
+	uint8_t *wram_data() { return wram.data(); }
+	uint8_t *hram_data() { return hram.data(); }
+
+	// rom bank mapped at addr, for traces
+	uint16_t rom_bank(uint16_t addr) const {
+		if (addr < 0x4000 || cart == nullptr) { return 0; }
+		return cart->current_rom_bank();
+	}
+
 private:
 
+	void init_io_handlers();
 	void request_dma_transfer(uint8_t src);
 	std::vector<uint8_t> wram;
-	std::vector<uint8_t> IO; // TODO - put this in it's own thing eventually
+	std::vector<uint8_t> IO; // backing store for registers without a handler
 	std::vector<uint8_t> hram;
 
 	std::unique_ptr<Cartridge> cart{nullptr};
-	std::shared_ptr<JoyPad> m_joypad{nullptr};
-	std::shared_ptr<Timer> m_timer{nullptr};
-	std::shared_ptr<InterruptObserver> m_int_observer{nullptr};
-	std::shared_ptr<Ppu> m_ppu{nullptr};
-
-	// enhancement: have a map for objects that want to register their high and low addr areas and a callback
-	// or create a radix tree for these callbacks
-	// Maybe most helpful for the IO space
+	JoyPad *m_joypad{nullptr};
+	Timer *m_timer{nullptr};
+	InterruptObserver *m_int_observer{nullptr};
+	Ppu *m_ppu{nullptr};
+	Serial *m_serial{nullptr};
+
+	// one handler per IO register, indexed by addr & 0x7F
+	std::array<IoHandler, IO_REGISTER_COUNT> m_io_handlers{};
 };
 
+// the accessors are defined here so the cpu's fetches and loads/stores inline
+
+inline uint8_t MemoryBus::read_byte(uint16_t addr) {
+    if (addr >= ROM_BASE && addr <= ROM_END) {
+        return cart->read_byte(addr);
+    }
+    else if (addr >= EXRAM_BASE && addr <= EXRAM_END) {
+        return cart->read_byte(addr);
+    }
+    else if (addr >= VRAM_BASE && addr <= VRAM_END) {
+        return m_ppu->read_byte(addr);
+    }
+    else if (addr >= WRAM_BASE && addr <= WRAM_END) {
+        return wram[addr - WRAM_BASE];
+    }
+    else if (addr >= ECHO_BASE && addr <= ECHO_END) {
+        return wram[addr - ECHO_BASE];
+    }
+    else if (addr >= HRAM_BASE && addr <= HRAM_END) {
+        return hram[addr - HRAM_BASE];
+    }
+    else if (addr >= IO_BASE && addr <= IO_END) {
+        const IoHandler &io = m_io_handlers[addr & 0x7F];
+        return io.read(io.ctx, addr);
+    }
+    else if (addr >= OAM_BASE && addr <= OAM_END) {
+        return m_ppu->read_byte(addr);
+    }
+    else if (addr == IE_ADDR) {
+        return m_int_observer->read_byte(IE_ADDR);
+    } else if (addr >= PROHIB_BASE && addr <= PROHIB_END) {
+        return 00;
+    } else {
+       //fmt::print("Illegal memory access: {:#04x}\n", addr);
+       exit(-1);
+    }
+    return 0;
+}
+
+inline void MemoryBus::write_byte(uint16_t addr, uint8_t value) {
+    if (addr >= ROM_BASE && addr <= ROM_END) {
+        cart->write_byte(addr, value);
+    }
+    else if (addr >= EXRAM_BASE && addr <= EXRAM_END) {
+        cart->write_byte(addr, value);
+    }
+    else if (addr >= VRAM_BASE && addr <= VRAM_END) {
+        m_ppu->write_byte(addr, value);
+    }
+    else if (addr >= WRAM_BASE && addr <= WRAM_END) {
+        wram[addr - WRAM_BASE] = value;
+    }
+    else if (addr >= ECHO_BASE && addr <= ECHO_END) {
+        wram[addr - ECHO_BASE] = value;
+    }
+    else if (addr >= HRAM_BASE && addr <= HRAM_END) {
+        hram[addr - HRAM_BASE] = value;
+    }
+    else if (addr >= IO_BASE && addr <= IO_END) {
+        const IoHandler &io = m_io_handlers[addr & 0x7F];
+        io.write(io.ctx, addr, value);
+    }
+    else if (addr >= OAM_BASE && addr <= OAM_END) {
+        m_ppu->write_byte(addr, value);
+    } else if (addr == IE_ADDR) {
+        m_int_observer->write_byte(IE_ADDR, value);
+    } else {
+       //fmt::print("Illegal memory access: {:#04x}\n", addr);
+    }
+    return;
+}
+
+inline uint16_t MemoryBus::read_word(uint16_t addr) {
+    uint16_t lo, hi;
+    lo = read_byte(addr);
+    hi = read_byte(addr + 1);
+    return ((hi << 8) & 0xFF00) | (lo & 0xFF);
+}
+
+inline void MemoryBus::write_word(uint16_t addr, uint16_t value) {
+    // lo write
+    write_byte(addr, value & 0xFF);
+    // hi write
+    write_byte(addr + 1, (value >> 8) & 0xFF);
+}
+
 #endif
@@ -0,0 +1,40 @@
+#ifndef NET_SOCKET_H
+#define NET_SOCKET_H
+
+#include <cstddef>
+#include <string>
+
+/*
+ * NetSocket
+ * A connected stream socket to one peer. An address of the form
+ * "host:port" is TCP, anything else is the path of a Unix socket, so two
+ * instances on the same machine can talk without touching the network.
+ */
+class NetSocket {
+public:
+    NetSocket() = default;
+    NetSocket(const NetSocket &) = delete;
+    NetSocket &operator=(const NetSocket &) = delete;
+    NetSocket(NetSocket &&other) noexcept;
+    NetSocket &operator=(NetSocket &&other) noexcept;
+    ~NetSocket();
+
+    // wait for one peer to connect to address
+    bool listen(const std::string &address);
+    // connect to a peer listening on address, retrying for up to timeout_ms
+    // so both sides can be started at the same time
+    bool connect(const std::string &address, int timeout_ms = 5000);
+    void close();
+    bool is_open() const { return m_fd >= 0; }
+
+    // sends all len bytes, false if the peer is gone
+    bool send_all(const void *data, size_t len);
+    // reads up to len bytes, waiting for at least one if wait is set.
+    // Returns the bytes read, 0 if nothing was there, -1 if the peer is gone
+    long receive(void *data, size_t len, bool wait);
+
+private:
+    int m_fd{-1};
+};
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "LinkCable.h"
+#include "NetSocket.h"
+#include "System.h"
+
+// frames the remote buttons may be predicted ahead before waiting on the peer
+constexpr int ROLLBACK_FRAMES = 8;
+
+struct NetplayStats {
+    uint64_t rollbacks{0};
+    uint64_t frames_resimulated{0};
+    // frames spent waiting because the peer fell ROLLBACK_FRAMES behind
+    uint64_t stalls{0};
+    // longest restore + re-simulation, should stay well inside a 16.7 ms frame
+    double max_rollback_ms{0};
+};
+
+// emulator settings that change how a system runs, both peers have to use
+// the same ones for both gameboys or they drift apart without noticing
+struct NetplaySettings {
+    bool idle_skip{true};
+};
+
+// run once right after connecting, before any frame. Both sides send their
+// settings and the joining side takes the host's. Returns false if the peer
+// is gone or isn't a compatible Microboy
+bool netplay_handshake(NetSocket &socket, bool host, NetplaySettings &settings);
+
+/*
+ * Netplay
+ * Rollback link play between two processes. Both peers emulate both
+ * gameboys connected by a LinkCable, so everything crossing the cable
+ * follows from the buttons alone and only the buttons travel over the
+ * socket, one small packet per frame. The peer's buttons are predicted to
+ * stay as they were last seen. When the real ones arrive and differ, both
+ * systems are restored from the snapshot taken before that frame and the
+ * frames since are run again.
+ */
+class Netplay {
+public:
+    // left and right must be reset with their carts loaded. Both peers pass
+    // the systems in the same order, local_side is the one this player holds
+    Netplay(System &left, System &right, int local_side, NetSocket socket);
+    Netplay(const Netplay &) = delete;
+    Netplay &operator=(const Netplay &) = delete;
+
+    // run one frame with the local player's buttons (JoyPad::buttons()
+    // layout), rolling back first if a prediction turned out wrong. Returns
+    // false once the peer disconnected
+    bool run_frame(uint8_t local_buttons);
+
+    System &local() { return *m_systems[m_local]; }
+    uint32_t frame() const { return m_frame; }
+    const NetplayStats &stats() const { return m_stats; }
+
+private:
+    struct Snapshot {
+        System systems[2];
+        uint64_t cable_cycles{0};
+    };
+    // buttons each side runs a frame with, for frames the peer is ahead on
+    // only the remote side is filled in
+    struct FrameInput {
+        uint8_t buttons[2]{};
+    };
+    struct InputPacket {
+        uint32_t frame;
+        uint8_t buttons;
+        uint8_t reserved[3];
+    };
+    static_assert(sizeof(InputPacket) == 8);
+
+    // read whatever the peer sent, returns the first already simulated frame
+    // whose prediction was wrong or m_frame if none, -1 if the peer is gone
+    int64_t receive(bool wait);
+    // snapshot the state before frame then run it with its inputs
+    void simulate(uint32_t frame);
+    void rollback(uint32_t frame);
+
+    System *m_systems[2];
+    LinkCable m_cable;
+    int m_local;
+    int m_remote;
+    NetSocket m_socket;
+
+    // both indexed by frame % size. Inputs reach ROLLBACK_FRAMES back for
+    // rollbacks and as far ahead as the peer may run
+    std::vector<Snapshot> m_snapshots;
+    std::array<FrameInput, 2 * (ROLLBACK_FRAMES + 1)> m_inputs{};
+
+    uint32_t m_frame{0};        // next frame to run
+    uint32_t m_confirmed{0};    // frames with the peer's real buttons
+    uint8_t m_remote_buttons{0}; // latest real buttons from the peer, the prediction
+    uint8_t m_packet[sizeof(InputPacket)]{};
+    size_t m_packet_len{0};
+    NetplayStats m_stats{};
+};
+
+#endif
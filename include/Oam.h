@@ -8,10 +8,13 @@ constexpr uint8_t SPRITE_X_FLIP = 5;
 constexpr uint8_t SPRITE_Y_FLIP = 6;
 constexpr uint8_t SPRITE_BG_PRI = 7;
 
-#pragma pack(push, 0)
+constexpr int OAM_SPRITE_COUNT = 40;
+constexpr int MAX_SPRITES_PER_LINE = 10;
+
+// Same layout as an entry in OAM memory
 struct OamAttribute {
-    int y_pos;
-    int x_pos;
+    uint8_t y_pos;  // screen y + 16
+    uint8_t x_pos;  // screen x + 8
     uint8_t tile_index;
     /* OAM Attributes
      * Bit7   BG and Window over OBJ (0=No, 1=BG and Window colors 1-3 over the OBJ)
@@ -22,7 +25,14 @@ struct OamAttribute {
      * Bit2-0 Palette number  **CGB Mode Only**     (OBP0-7) */
     uint8_t attributes;
 };
-#pragma pack(pop)
+static_assert(sizeof(OamAttribute) == 4);
+
+// A sprite pixel in the line buffer, color_val 0 means no sprite here
+struct SpritePixel {
+    uint8_t color_val;
+    uint8_t palette;
+    bool bg_priority;
+};
 
 
 #endif
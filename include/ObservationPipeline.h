@@ -0,0 +1,73 @@
+#ifndef OBSERVATION_PIPELINE_H
+#define OBSERVATION_PIPELINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common.h"
+
+struct ObservationConfig {
+    // part of the screen kept
+    int crop_x{0};
+    int crop_y{0};
+    int crop_width{dmg::WIDTH};
+    int crop_height{dmg::HEIGHT};
+    // size the crop is scaled to
+    int width{84};
+    int height{84};
+    // frames kept, oldest first
+    int stack{4};
+};
+
+/*
+ * ObservationPipeline
+ * Turns frames into what agents look at: grayscale, cropped, scaled down
+ * and stacked with the frames before them. Each output pixel is the
+ * average of the screen pixels it covers. push() every finished frame,
+ * write() copies the stack out, one byte per pixel, oldest frame first.
+ * Settings out of range are clamped.
+ */
+class ObservationPipeline {
+public:
+    explicit ObservationPipeline(ObservationConfig config = {});
+
+    const ObservationConfig &config() const { return m_config; }
+    // bytes in the stack, stack * height * width
+    size_t size() const { return m_frames.size(); }
+    // every frame in the stack back to black
+    void clear();
+    // frame replaces the oldest frame in the stack
+    void push(const uint32_t *frame);
+    // same for a frame of shades from an indexed ppu, each shade counts as
+    // the gray of its gPalette color
+    void push(const uint8_t *shades);
+    void write(uint8_t *out) const;
+
+private:
+    // source pixels [first, last) averaged into one output pixel
+    struct Span {
+        int first;
+        int last;
+    };
+    static std::vector<Span> make_spans(int from, int to);
+    template <typename Pixel>
+    void push_frame(const Pixel *frame);
+
+    ObservationConfig m_config;
+    std::vector<Span> m_columns;
+    std::vector<Span> m_rows;
+    // 1/(pixels covered) per output pixel in 32.32 fixed point, row major
+    std::vector<uint64_t> m_scale;
+    // sums of gray over the rows of the current output row, then running
+    // totals of those so a column span is one subtraction
+    std::vector<uint16_t> m_row_sums;
+    std::vector<uint32_t> m_prefix;
+    // gray of each shade
+    std::array<uint16_t, 4> m_shade_gray{};
+    std::vector<uint8_t> m_frames;
+    int m_newest{0};
+};
+
+#endif
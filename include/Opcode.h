@@ -1,19 +1,21 @@
 #ifndef OPCODE_H
 #define OPCODE_H
 
-#include <string>
+#include <string_view>
 #include "common.h"
 
+// the tables are constexpr so they cost nothing at startup and handlers can
+// use an opcode's length and cycles as compile time constants
 struct Opcode {
-	std::string name;
-	std::string group; // replace this with the helpful info on what to grab?
-	std::string flags;
+	std::string_view name;
+	std::string_view group; // replace this with the helpful info on what to grab?
+	std::string_view flags;
 	uint8_t len;
 	uint8_t cycles;
 	uint8_t cycles_extra;
 };
 
-static const Opcode CYCLE_TABLE_DEBUG[0x100] = {
+inline constexpr Opcode CYCLE_TABLE_DEBUG[0x100] = {
 	{"NOP","control/misc","----",1,4,4}, {"LD BC,u16","x16/lsm","----",3,12,12}, {"LD (BC),A","x8/lsm","----",1,8,8}, {"INC BC","x16/alu","----",1,8,8}, {"INC B","x8/alu","Z0H-",1,4,4}, {"DEC B","x8/alu","Z1H-",1,4,4}, {"LD B,u8","x8/lsm","----",2,8,8}, {"RLCA","x8/rsb","000C",1,4,4}, {"LD (u16),SP","x16/lsm","----",3,20,20}, {"ADD HL,BC","x16/alu","-0HC",1,8,8}, {"LD A,(BC)","x8/lsm","----",1,8,8}, {"DEC BC","x16/alu","----",1,8,8}, {"INC C","x8/alu","Z0H-",1,4,4}, {"DEC C","x8/alu","Z1H-",1,4,4}, {"LD C,u8","x8/lsm","----",2,8,8}, {"RRCA","x8/rsb","000C",1,4,4},
 	{"STOP","control/misc","----",0,4,4}, {"LD DE,u16","x16/lsm","----",3,12,12}, {"LD (DE),A","x8/lsm","----",1,8,8}, {"INC DE","x16/alu","----",1,8,8}, {"INC D","x8/alu","Z0H-",1,4,4}, {"DEC D","x8/alu","Z1H-",1,4,4}, {"LD D,u8","x8/lsm","----",2,8,8}, {"RLA","x8/rsb","000C",1,4,4}, {"JR i8","control/br","----",2,12,12}, {"ADD HL,DE","x16/alu","-0HC",1,8,8}, {"LD A,(DE)","x8/lsm","----",1,8,8}, {"DEC DE","x16/alu","----",1,8,8}, {"INC E","x8/alu","Z0H-",1,4,4}, {"DEC E","x8/alu","Z1H-",1,4,4}, {"LD E,u8","x8/lsm","----",2,8,8}, {"RRA","x8/rsb","000C",1,4,4},
 	{"JR NZ,i8","control/br","----",2,8,12}, {"LD HL,u16","x16/lsm","----",3,12,12}, {"LD (HL+),A","x8/lsm","----",1,8,8}, {"INC HL","x16/alu","----",1,8,8}, {"INC H","x8/alu","Z0H-",1,4,4}, {"DEC H","x8/alu","Z1H-",1,4,4}, {"LD H,u8","x8/lsm","----",2,8,8}, {"DAA","x8/alu","Z-0C",1,4,4}, {"JR Z,i8","control/br","----",2,8,12}, {"ADD HL,HL","x16/alu","-0HC",1,8,8}, {"LD A,(HL+)","x8/lsm","----",1,8,8}, {"DEC HL","x16/alu","----",1,8,8}, {"INC L","x8/alu","Z0H-",1,4,4}, {"DEC L","x8/alu","Z1H-",1,4,4}, {"LD L,u8","x8/lsm","----",2,8,8}, {"CPL","x8/alu","-11-",1,4,4},
@@ -33,7 +35,7 @@ static const Opcode CYCLE_TABLE_DEBUG[0x100] = {
 };
 
 
-static const Opcode CYCLE_TABLE_DEBUG_CB[0x100] = {
+inline constexpr Opcode CYCLE_TABLE_DEBUG_CB[0x100] = {
 	{"RLC B","x8/rsb","Z00C",2,8,8}, {"RLC C","x8/rsb","Z00C",2,8,8}, {"RLC D","x8/rsb","Z00C",2,8,8}, {"RLC E","x8/rsb","Z00C",2,8,8}, {"RLC H","x8/rsb","Z00C",2,8,8}, {"RLC L","x8/rsb","Z00C",2,8,8}, {"RLC (HL)","x8/rsb","Z00C",2,16,16}, {"RLC A","x8/rsb","Z00C",2,8,8}, {"RRC B","x8/rsb","Z00C",2,8,8}, {"RRC C","x8/rsb","Z00C",2,8,8}, {"RRC D","x8/rsb","Z00C",2,8,8}, {"RRC E","x8/rsb","Z00C",2,8,8}, {"RRC H","x8/rsb","Z00C",2,8,8}, {"RRC L","x8/rsb","Z00C",2,8,8}, {"RRC (HL)","x8/rsb","Z00C",2,16,16}, {"RRC A","x8/rsb","Z00C",2,8,8},
 	{"RL B","x8/rsb","Z00C",2,8,8}, {"RL C","x8/rsb","Z00C",2,8,8}, {"RL D","x8/rsb","Z00C",2,8,8}, {"RL E","x8/rsb","Z00C",2,8,8}, {"RL H","x8/rsb","Z00C",2,8,8}, {"RL L","x8/rsb","Z00C",2,8,8}, {"RL (HL)","x8/rsb","Z00C",2,16,16}, {"RL A","x8/rsb","Z00C",2,8,8}, {"RR B","x8/rsb","Z00C",2,8,8}, {"RR C","x8/rsb","Z00C",2,8,8}, {"RR D","x8/rsb","Z00C",2,8,8}, {"RR E","x8/rsb","Z00C",2,8,8}, {"RR H","x8/rsb","Z00C",2,8,8}, {"RR L","x8/rsb","Z00C",2,8,8}, {"RR (HL)","x8/rsb","Z00C",2,16,16}, {"RR A","x8/rsb","Z00C",2,8,8},
 	{"SLA B","x8/rsb","Z00C",2,8,8}, {"SLA C","x8/rsb","Z00C",2,8,8}, {"SLA D","x8/rsb","Z00C",2,8,8}, {"SLA E","x8/rsb","Z00C",2,8,8}, {"SLA H","x8/rsb","Z00C",2,8,8}, {"SLA L","x8/rsb","Z00C",2,8,8}, {"SLA (HL)","x8/rsb","Z00C",2,16,16}, {"SLA A","x8/rsb","Z00C",2,8,8}, {"SRA B","x8/rsb","Z00C",2,8,8}, {"SRA C","x8/rsb","Z00C",2,8,8}, {"SRA D","x8/rsb","Z00C",2,8,8}, {"SRA E","x8/rsb","Z00C",2,8,8}, {"SRA H","x8/rsb","Z00C",2,8,8}, {"SRA L","x8/rsb","Z00C",2,8,8}, {"SRA (HL)","x8/rsb","Z00C",2,16,16}, {"SRA A","x8/rsb","Z00C",2,8,8},
@@ -1,6 +1,7 @@
 #ifndef PPU_H
 #define PPU_H
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -11,11 +12,15 @@
 
 class MemoryBus;
 
+// the four shades of the screen, lightest first, in ARGB
+extern const std::vector<uint32_t> gPalette;
+
 inline constexpr int SCAN_LINE_CYCLES = 456;
 inline constexpr int OAM_CYCLES = 80;
 inline constexpr int VBLANK_LINES = 10;
 inline constexpr int PIXEL_TRANSFER_CYCLES = 172;
 inline constexpr int HBLANK_CYCLES = 204;
+inline constexpr int DMA_CYCLES = 640;
 inline constexpr uint16_t TILEMAP_1 = 0x9c00; 
 inline constexpr uint16_t TILEMAP_2 = 0x9800;
 inline constexpr uint16_t TILE_DATA_BASE_1 = 0x8000; 
@@ -28,52 +33,107 @@ public:
 
     bool step(int);
     void reset();
+    // cycles until the next VBLANK or STAT interrupt is requested
+    int cycles_until_interrupt();
+    // cycles until LY / the lcd mode next changes
+    int cycles_until_ly_change();
+    int cycles_until_mode_change();
 
 	uint8_t read_byte(uint16_t addr);
 	uint16_t read_word(uint16_t addr);
 	void write_byte(uint16_t addr, uint8_t value);
 	void write_word(uint16_t addr, uint16_t value);
 
-    void connect_interrupt_observer(std::shared_ptr<InterruptObserver> observer) { m_int_observer = observer; }
-    void connect_bus(std::weak_ptr<MemoryBus> bus) { m_bus = bus; }
-    uint32_t * get_frame_buffer() { return m_frame_buffer.data(); }
+    void connect_interrupt_observer(InterruptObserver *observer) { m_int_observer = observer; }
+    void connect_bus(MemoryBus *bus) { m_bus = bus; }
+    // LCD registers and DMA, VRAM and OAM go through read_byte/write_byte
+    void register_io_handlers(MemoryBus &bus);
+    // the frame in ARGB, in indexed mode the colors are filled in here
+    uint32_t * get_frame_buffer();
+    // indexed mode draws each pixel's shade, 0-3 after the palette
+    // registers, one byte per pixel instead of a 32 bit color. gPalette is
+    // only applied once get_frame_buffer() asks for the colors
+    void set_indexed(bool enabled);
+    bool indexed() const { return m_indexed; }
+    // dmg::WIDTH * dmg::HEIGHT shades, only drawn in indexed mode
+    const uint8_t *get_shade_buffer() const { return m_shade_buffer.data(); }
+    // with rendering off lines are timed and counted as usual but no pixels
+    // are drawn, the frame buffer keeps whatever it last held
+    void set_rendering(bool enabled) { m_rendering = enabled; }
+    bool rendering() const { return m_rendering; }
+    // direct access to VRAM for bulk copies, nullptr while the cpu is locked out
+    uint8_t *vram_ptr(uint16_t addr, uint16_t len);
+    // all of VRAM whether the cpu is locked out or not, lives as long as the ppu
+    uint8_t *vram_data() { return m_vram.data(); }
+
+    // OAM DMA state, OAM is locked to the cpu while a transfer is running
+    bool dma_active() const { return m_dma_cycles > 0; }
+    // returns true once after each transfer finishes
+    bool dma_completed() {
+        bool completed = m_dma_completed;
+        m_dma_completed = false;
+        return completed;
+    }
 
 private:
     void request_dma_transfer(uint8_t addr);
+    void step_dma(int cycles);
     void ppu_switch_mode(LcdMode);
     int ppu_mode_hblank(int cycles);
     int ppu_mode_vblank(int cycles);
     int ppu_mode_data_xfer(int cycles);
     int ppu_mode_oam_search(int cycles);
     void search_oam();
+    void build_sprite_lines();
     void render_background();
     void render_window();
     void render_sprites();
+    void put_pixel(int x, uint8_t shade) {
+        int i = m_lcd.LY * dmg::WIDTH + x;
+        if (m_indexed) {
+            m_shade_buffer[i] = shade;
+        } else {
+            m_frame_buffer[i] = gPalette[shade];
+        }
+    }
 
     bool m_frame_ready{false};
+    bool m_rendering{true};
+    bool m_indexed{false};
+    // the shades were drawn to since the frame buffer was last filled in
+    bool m_colors_stale{false};
     uint16_t LX{0};
     uint16_t WLY{0};
     uint8_t m_sprites_visible{0};
     bool m_vram_blocked{false};
     bool m_oam_blocked{false};
+    uint8_t m_dma_source{0};
+    int m_dma_cycles{0};
+    bool m_dma_completed{false};
     uint32_t m_dots{0};
     LcdMode m_mode{LcdMode::HBLANK};
     Lcd m_lcd{};
     bool m_was_window_drawn{false};
-    OamAttribute *m_current_sprite{nullptr};
-    bool m_sprite_rendering_started{false};
+    // BG/window color index and sprite pixels for the line being drawn
+    std::array<uint8_t, dmg::WIDTH> m_bg_line{};
+    std::array<SpritePixel, dmg::WIDTH> m_sprite_line{};
 
 	std::vector<uint8_t> m_vram{};
 	std::vector<uint8_t> m_oam{};
 
-    // TODO see if we need this
-    std::vector<OamAttribute> m_oam_table{};
+    // Sprites covering each line: the first 10 in OAM order, sorted by x.
+    // Only rebuilt when OAM or the object size changes
+    std::array<std::array<OamAttribute, MAX_SPRITES_PER_LINE>, dmg::HEIGHT> m_line_sprites{};
+    std::array<uint8_t, dmg::HEIGHT> m_line_sprite_count{};
+    bool m_sprite_lines_dirty{true};
+    bool m_sprite_lines_tall{false};
 
-    std::weak_ptr<MemoryBus> m_bus{};
+    MemoryBus *m_bus{nullptr};
     std::vector<uint32_t> m_frame_buffer{};
+    std::vector<uint8_t> m_shade_buffer{};
 
     // Interrupt observer so we can schedule interrupts
-    std::shared_ptr<InterruptObserver> m_int_observer{};
+    InterruptObserver *m_int_observer{nullptr};
 };
 
 #endif
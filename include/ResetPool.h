@@ -0,0 +1,38 @@
+#ifndef RESET_POOL_H
+#define RESET_POOL_H
+
+#include <vector>
+
+#include "Cartridge.h"
+#include "System.h"
+
+/*
+ * ResetPool
+ * Snapshots to restart a game from without going back to the rom file or
+ * replaying its intro. Slot 0 is the state the pool starts with, usually the
+ * system just after reset and load_cart, further slots are saved by the
+ * caller, past a title screen for example. The snapshots share their rom with
+ * every system restored from them, a restore copies memory, registers and
+ * cartridge ram in place and takes a few microseconds. Restoring only reads
+ * the pool, so one pool can serve systems on any number of threads.
+ */
+class ResetPool {
+public:
+    // slot 0 is a freshly reset system with a cartridge made from rom
+    explicit ResetPool(RomImage rom);
+    // slot 0 is start as it is now
+    explicit ResetPool(const System &start);
+
+    // keeps a copy of system in a new slot and returns the slot
+    int save(const System &system);
+    // replaces the snapshot in slot
+    void save(int slot, const System &system);
+    // puts system back to slot, it stays plugged into whatever it was
+    void restore(System &system, int slot = 0) const;
+    int size() const { return static_cast<int>(m_snapshots.size()); }
+
+private:
+    std::vector<System> m_snapshots;
+};
+
+#endif
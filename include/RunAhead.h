@@ -0,0 +1,39 @@
+#ifndef RUN_AHEAD_H
+#define RUN_AHEAD_H
+
+#include <cstdint>
+
+#include "System.h"
+
+/*
+ * RunAhead
+ * Hides the frame or two most games take to react to a button. Every frame
+ * the system runs one frame as usual, then a copy of it runs frames further
+ * with the same buttons held and the copy's last frame is the one shown.
+ * Only the frames leading up to that one are drawn, the rest run with
+ * rendering off, so the cost stays close to frames + 1 frames of cpu time.
+ * The copy is detached from traces, the serial port and the host's input
+ * so nothing outside sees it run.
+ */
+class RunAhead {
+public:
+    // frames = 0 just runs the system
+    RunAhead(System &system, int frames);
+    RunAhead(const RunAhead &) = delete;
+    RunAhead &operator=(const RunAhead &) = delete;
+
+    void set_frames(int frames);
+    int frames() const { return m_frames; }
+    // returns true when there is a new frame to draw, the copy's when
+    // running ahead
+    bool run_frame();
+    // the frame to show, from the copy when running ahead
+    uint32_t *get_frame_buffer();
+
+private:
+    System &m_system;
+    System m_ahead{};
+    int m_frames;
+};
+
+#endif
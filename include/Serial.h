@@ -0,0 +1,77 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <cstdint>
+#include <limits>
+#include "InterruptObserver.h"
+
+class MemoryBus;
+
+// Serial Registers
+// SB: Serial transfer data, the byte to send, replaced by the byte received
+//      once the transfer completes
+// SC: Serial transfer control
+//      Bit 7 - Transfer Start Flag (1 = transfer requested or in progress)
+//      Bit 0 - Shift Clock (0 = external clock, 1 = internal clock 8192 Hz)
+//      Bits 1-6 are unused and read back as 1
+// With the internal clock a byte takes 8 bits * 512 cycles, afterwards bit 7
+// of SC is cleared and the serial interrupt is requested. With the external
+// clock the transfer waits for the other gameboy to clock it.
+
+// Serial addresses
+constexpr int SB_ADDR = 0xFF01;
+constexpr int SC_ADDR = 0xFF02;
+
+constexpr int SERIAL_CYCLES_PER_BYTE = 4096;
+
+/*
+ * SerialSink
+ * Whatever is plugged into the link port. transfer() gets the byte shifted
+ * out when a transfer completes and returns the byte shifted in.
+ */
+class SerialSink {
+public:
+    virtual ~SerialSink() = default;
+    virtual uint8_t transfer(uint8_t out) = 0;
+};
+
+class Serial {
+public:
+    void reset();
+    void connect_interrupt_observer(InterruptObserver *int_obs) { m_int_obs = int_obs; }
+    // nullptr unplugs the sink, transfers then read 0xFF like an empty port
+    void connect_sink(SerialSink *sink) { m_sink = sink; }
+    SerialSink *sink() const { return m_sink; }
+    void register_io_handlers(MemoryBus &bus);
+    void step(int cycles);
+    // cycles until the running transfer completes and requests its interrupt
+    int cycles_until_interrupt() const;
+    // cycles until bit 7 of SC drops, 0 while it depends on the other side
+    int cycles_until_sc_change() const { return internal_transfer() ? m_cycles_left : 0; }
+
+    // a transfer on the internal clock is running
+    bool transferring() const { return internal_transfer(); }
+
+    // external clock, driven by whatever sits on the other end of the cable.
+    // waiting_for_clock() is true while SC asks for a transfer on the external
+    // clock, clock_in() then completes it and returns the byte shifted out
+    bool waiting_for_clock() const { return (m_sc & 0x81) == 0x80; }
+    uint8_t clock_in(uint8_t in);
+    // how long the other side is known to stay quiet, a waiting transfer
+    // counts as an interrupt that far ahead so halt doesn't sleep past it
+    void set_external_clock_horizon(int cycles) { m_external_horizon = cycles; }
+    uint8_t read_byte(uint16_t addr);
+    void write_byte(uint16_t addr, uint8_t val);
+
+private:
+    bool internal_transfer() const { return (m_sc & 0x81) == 0x81; }
+
+    uint8_t m_sb{0x00};
+    uint8_t m_sc{0x7E};
+    int m_cycles_left{0};
+    int m_external_horizon{std::numeric_limits<int>::max()};
+    SerialSink *m_sink{nullptr};
+    InterruptObserver *m_int_obs{nullptr};
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SYSTEM_H
+#define SYSTEM_H
+
+#include <memory>
+
+#include "Cartridge.h"
+#include "Cpu.h"
+#include "InterruptObserver.h"
+#include "JoyPad.h"
+#include "MemoryBus.h"
+#include "Ppu.h"
+#include "Serial.h"
+#include "Timer.h"
+
+/*
+ * System
+ * Owns every component of the gameboy and wires them together with plain
+ * pointers. Copying a System copies the whole machine, cartridge included,
+ * and points the copy's components at each other.
+ */
+struct System {
+    System();
+    System(const System &other);
+    System &operator=(const System &other);
+    ~System() = default;
+
+    void reset();
+    void load_cart(std::unique_ptr<Cartridge> cart);
+    // copies snapshot's state over this system but keeps what it is plugged
+    // into, its trace, serial sink and host input, and how it renders
+    void restore(const System &snapshot);
+    // run until the ppu finishes a frame or a frame's worth of cycles went by,
+    // returns true when there is a new frame to draw
+    bool run_frame();
+    // run until cpu.cycles() reaches cycle, returns true if the ppu finished
+    // a frame on the way. Overshoots by at most one instruction plus an
+    // interrupt dispatch, halts and skipped loops stop at cycle
+    bool run_until(uint64_t cycle);
+
+    Cpu cpu{};
+    InterruptObserver int_obs{};
+    JoyPad joypad{};
+    Timer timer{};
+    Serial serial{};
+    Ppu ppu{};
+    MemoryBus bus{};
+
+private:
+    void connect();
+    // steps everything but the cpu, returns true when the ppu finished a frame
+    bool step_components(int cycles);
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include <memory>
 #include "InterruptObserver.h"
 
+class MemoryBus;
+
 // Timer Registers
 // DIV: is incremented at a rate of 16384 hz, will inc at double speed (32768 Hz) on CGB
 //      Writing to this reg resets the value to 00
@@ -32,8 +34,14 @@ constexpr int DIV_FREQ = 256;
 class Timer {
 public:
     void reset();
-    void connect_interrupt_observer(std::shared_ptr<InterruptObserver> int_obs);
+    void connect_interrupt_observer(InterruptObserver *int_obs);
+    void register_io_handlers(MemoryBus &bus);
     void step(int cycles);
+    // cycles until the next timer interrupt is requested
+    int cycles_until_interrupt() const;
+    // cycles until the DIV / TIMA registers next change
+    int cycles_until_div_change() const;
+    int cycles_until_tima_change() const;
     uint8_t read_byte(uint16_t addr);
     void write_byte(uint16_t addr, uint8_t val);
 
@@ -48,7 +56,7 @@ private:
     uint16_t m_cycles_until_next_tima {0};
     uint16_t m_cycles_until_next_div{0};
     bool m_tima_overflow {false};
-    std::shared_ptr<InterruptObserver> m_int_obs{nullptr};
+    InterruptObserver *m_int_obs{nullptr};
 };
 
 #endif
@@ -0,0 +1,53 @@
+#ifndef TRACE_BUS_H
+#define TRACE_BUS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "FlatBus.h"
+
+enum class BusAccessType : uint8_t {
+	READ,
+	WRITE,
+};
+
+struct BusAccess {
+	uint16_t addr;
+	uint8_t value;
+	BusAccessType type;
+};
+
+/*
+ * TraceBus
+ * A FlatBus that records every access in order, words are logged as their
+ * two byte accesses. Used to check the cpu's memory traffic per instruction
+ */
+class TraceBus : public FlatBus {
+public:
+	uint8_t read_byte(uint16_t addr) {
+		uint8_t value = FlatBus::read_byte(addr);
+		m_accesses.push_back({addr, value, BusAccessType::READ});
+		return value;
+	}
+	uint16_t read_word(uint16_t addr) {
+		uint8_t lo = read_byte(addr);
+		uint8_t hi = read_byte(addr + 1);
+		return lo | (hi << 8);
+	}
+	void write_byte(uint16_t addr, uint8_t value) {
+		m_accesses.push_back({addr, value, BusAccessType::WRITE});
+		FlatBus::write_byte(addr, value);
+	}
+	void write_word(uint16_t addr, uint16_t value) {
+		write_byte(addr, value & 0xFF);
+		write_byte(addr + 1, value >> 8);
+	}
+
+	const std::vector<BusAccess> &accesses() const { return m_accesses; }
+	void clear_accesses() { m_accesses.clear(); }
+
+private:
+	std::vector<BusAccess> m_accesses{};
+};
+
+#endif
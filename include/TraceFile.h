@@ -0,0 +1,103 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Binary instruction trace
+ * The cpu writes one fixed size record per instruction into a file mapped
+ * with mmap, so tracing costs a few stores instead of a printf per register.
+ * The file is a ring, once it is full the oldest records get overwritten.
+ * tools/trace_decode turns a trace back into text.
+ */
+
+constexpr char TRACE_MAGIC[8] = {'M', 'B', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr size_t TRACE_DEFAULT_RECORDS = size_t{1} << 22; // 128 MB
+
+// cpu state right before an instruction runs
+struct TraceRecord {
+	uint64_t cycle;		// cycles since reset
+	uint16_t pc;
+	uint16_t sp;
+	uint8_t a, f, b, c, d, e, h, l;
+	uint8_t pc_mem[4];	// bytes at pc..pc+3
+	uint16_t bank;		// rom bank mapped at pc, 0 below 0x4000
+	uint8_t reserved[6];
+};
+static_assert(sizeof(TraceRecord) == 32);
+
+struct TraceFileHeader {
+	char magic[8];
+	uint32_t record_size;
+	uint32_t reserved;
+	uint64_t capacity;	// records in the ring, a power of 2
+	uint64_t count;		// records ever written
+};
+static_assert(sizeof(TraceFileHeader) == 32);
+
+// "A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02",
+// the Gameboy Doctor log line for a record. with_bank writes the pc as
+// "PC:01:4000", 3 characters longer. No newline or terminator is added
+constexpr size_t DOCTOR_LINE_LENGTH = 73;
+size_t format_doctor_line(const TraceRecord &record, char *out, bool with_bank = false);
+
+class TraceWriter {
+public:
+	TraceWriter() = default;
+	TraceWriter(const TraceWriter &) = delete;
+	TraceWriter &operator=(const TraceWriter &) = delete;
+	~TraceWriter();
+
+	// creates or truncates the file and maps room for capacity records
+	// (rounded up to a power of 2), returns false if that fails
+	bool open(const std::string &filename, size_t capacity = TRACE_DEFAULT_RECORDS);
+	void close();
+	bool is_open() const { return m_header != nullptr; }
+
+	// slot for the next record, overwriting the oldest when the ring is full
+	TraceRecord &next() {
+		TraceRecord &record = m_records[m_header->count & m_mask];
+		++m_header->count;
+		return record;
+	}
+
+private:
+	TraceFileHeader *m_header{nullptr};
+	TraceRecord *m_records{nullptr};
+	uint64_t m_mask{0};
+	size_t m_mapped_size{0};
+};
+
+// read only view of a trace file, records are indexed oldest first
+class TraceReader {
+public:
+	TraceReader() = default;
+	TraceReader(const TraceReader &) = delete;
+	TraceReader &operator=(const TraceReader &) = delete;
+	~TraceReader();
+
+	// returns false if the file can't be mapped or isn't a trace
+	bool open(const std::string &filename);
+	void close();
+
+	size_t size() const { return m_size; }
+	// records overwritten after the ring wrapped, record 0 is instruction
+	// dropped() + 1 counting from 1
+	uint64_t dropped() const { return m_first; }
+	const TraceRecord &operator[](size_t i) const { return m_records[(m_first + i) & m_mask]; }
+	// the records as at most two contiguous runs, oldest first
+	const TraceRecord *first_run(size_t &len) const;
+	const TraceRecord *second_run(size_t &len) const;
+
+private:
+	const TraceFileHeader *m_header{nullptr};
+	const TraceRecord *m_records{nullptr};
+	uint64_t m_mask{0};
+	uint64_t m_first{0};
+	size_t m_size{0};
+	size_t m_mapped_size{0};
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef VEC_ENV_H
+#define VEC_ENV_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Cartridge.h"
+#include "ObservationPipeline.h"
+#include "ResetPool.h"
+#include "System.h"
+
+// what each env writes into the observation buffer
+struct VecEnvObservation {
+    // the frame buffer, dmg::WIDTH * dmg::HEIGHT pixels of uint32_t. Without
+    // it the envs run with rendering off
+    bool frame{true};
+    // the frame as dmg::WIDTH * dmg::HEIGHT shades of one byte each, see
+    // Ppu::set_indexed
+    bool shades{false};
+    // the frame grayscaled, scaled and stacked by an ObservationPipeline,
+    // pushed at the end of each step that finished a frame
+    bool stacked{false};
+    ObservationConfig stacking{};
+    // ram_len bytes read through the bus from ram_addr, 0 for none
+    uint16_t ram_addr{0xC000};
+    uint16_t ram_len{0};
+};
+
+/*
+ * VecEnv
+ * Many copies of one game stepped together, for training agents. A step
+ * takes every env's buttons in one array, runs all envs on a pool of
+ * threads and writes all observations into one buffer the caller owns,
+ * laid out field by field rather than env by env:
+ *     frames  size() * dmg::WIDTH * dmg::HEIGHT uint32_t pixels
+ *     shades  size() * dmg::WIDTH * dmg::HEIGHT bytes, from shade_offset()
+ *     stacks  size() * stack size bytes, from stack_offset()
+ *     ram     size() * ram_len bytes, from ram_offset()
+ * so each field is one contiguous array to hand on as is. The envs share
+ * the rom and restart from the snapshots in pool().
+ */
+class VecEnv {
+public:
+    // threads = 0 uses one per core, the calling thread counts as one
+    VecEnv(RomImage rom, int count, VecEnvObservation observation, int threads = 0);
+    VecEnv(const VecEnv &) = delete;
+    VecEnv &operator=(const VecEnv &) = delete;
+    ~VecEnv();
+
+    int size() const { return static_cast<int>(m_envs.size()); }
+    System &env(int i) { return m_envs[i]; }
+    // slot 0 is the state right after loading, save more to reset to them
+    ResetPool &pool() { return m_pool; }
+
+    void reset(int env, int slot = 0);
+    void reset_all(int slot = 0);
+
+    // every env holds buttons[i] (JoyPad::buttons() layout) for frames
+    // frames, then writes its observation into observations
+    void step(const uint8_t *buttons, int frames, void *observations);
+    // writes the current observations without running anything
+    void observe(void *observations);
+
+    // size of the buffer step and observe write to
+    size_t observation_bytes() const;
+    // where the shade, stack and ram sections start in that buffer
+    size_t shade_offset() const;
+    size_t stack_offset() const;
+    size_t ram_offset() const;
+
+private:
+    void write_observation(int env, uint8_t *observations);
+    // runs job(env) for every env across the pool, returns once all are done
+    void parallel(std::function<void(int)> job);
+    void worker();
+    // takes envs off the shared counter until none are left
+    void work();
+
+    ResetPool m_pool;
+    std::vector<System> m_envs;
+    VecEnvObservation m_observation;
+    // one per env when stacked
+    std::vector<ObservationPipeline> m_pipelines;
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::function<void(int)> m_job;
+    std::atomic<int> m_next{0};
+    int m_busy{0};
+    uint64_t m_generation{0};
+    bool m_stopping{false};
+};
+
+#endif
@@ -5,9 +5,12 @@
 
 #include <SFML/Graphics.hpp>
 #include "common.h"
+#include "HostInput.h"
 #include "JoyPad.h"
 
-void handle_key_pressed(sf::Event &event, JoyPad &joypad);
-void handle_key_released(sf::Event &event, JoyPad & joypad);
+// the button a key stands for, false for keys that aren't mapped
+bool key_to_input(sf::Keyboard::Key key, JoyPadInput &input);
+void handle_key_pressed(sf::Event &event, HostInput &host);
+void handle_key_released(sf::Event &event, HostInput &host);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef MICROBOY_H
+#define MICROBOY_H
+
+/*
+ * C interface to the emulator core, built as build/libmicroboy.so. Made for
+ * ctypes and other foreign function interfaces: plain functions, an opaque
+ * handle and no exceptions. Memory is handed out as pointers into the
+ * emulator itself, they stay valid until mb_destroy and always show the
+ * current state, so nothing has to be copied after a step.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define MB_API __attribute__((visibility("default")))
+#else
+#define MB_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped whenever a function changes in a way old callers would notice */
+#define MB_API_VERSION 1
+
+#define MB_WIDTH 160
+#define MB_HEIGHT 144
+
+/* buttons for mb_set_input, or them together */
+#define MB_BUTTON_DOWN   (1 << 0)
+#define MB_BUTTON_UP     (1 << 1)
+#define MB_BUTTON_LEFT   (1 << 2)
+#define MB_BUTTON_RIGHT  (1 << 3)
+#define MB_BUTTON_START  (1 << 4)
+#define MB_BUTTON_SELECT (1 << 5)
+#define MB_BUTTON_A      (1 << 6)
+#define MB_BUTTON_B      (1 << 7)
+
+typedef struct mb_system mb_system;
+
+/* see ObservationPipeline.h, out of range values are clamped */
+typedef struct mb_observation_config {
+    int crop_x;
+    int crop_y;
+    int crop_width;
+    int crop_height;
+    int width;
+    int height;
+    int stack;
+} mb_observation_config;
+
+MB_API int mb_api_version(void);
+
+/* a reset system with the rom loaded, NULL if the rom can't be loaded */
+MB_API mb_system *mb_create(const char *rom_path);
+MB_API mb_system *mb_create_from_memory(const uint8_t *rom, size_t size);
+MB_API void mb_destroy(mb_system *gb);
+
+/* runs frames frames, returns how many of them finished a new picture */
+MB_API int mb_step(mb_system *gb, int frames);
+/* buttons held from now on, MB_BUTTON_* bits */
+MB_API void mb_set_input(mb_system *gb, uint8_t buttons);
+/* rendering off skips drawing, the frame buffer keeps its last picture */
+MB_API void mb_set_rendering(mb_system *gb, int enabled);
+/* indexed drawing writes one shade (0-3) per pixel to mb_shade_buffer,
+   mb_frame_buffer then fills in the colors when it is called */
+MB_API void mb_set_indexed(mb_system *gb, int enabled);
+
+/* keeps a snapshot and returns its slot. Slot 0 is the state right after
+   loading the rom, so mb_load(gb, 0) resets */
+MB_API int mb_save(mb_system *gb);
+/* replaces the snapshot in slot, returns 0 or -1 for an unknown slot */
+MB_API int mb_save_slot(mb_system *gb, int slot);
+/* returns 0 or -1 for an unknown slot */
+MB_API int mb_load(mb_system *gb, int slot);
+
+/* grayscale, crop, scale and stack the frames into out: config->stack
+   frames of width * height bytes, oldest first. out is written when mb_step
+   finishes a frame and cleared by mb_load. Returns the bytes out needs,
+   with out = NULL only that and the pipeline is turned off */
+MB_API size_t mb_set_observation(mb_system *gb, const mb_observation_config *config, uint8_t *out);
+
+/* MB_WIDTH * MB_HEIGHT pixels, row by row, 0xAARRGGBB */
+MB_API const uint32_t *mb_frame_buffer(mb_system *gb);
+/* MB_WIDTH * MB_HEIGHT shades, only drawn while indexed */
+MB_API const uint8_t *mb_shade_buffer(mb_system *gb);
+/* the 4 colors of the shades, lightest first, 0xAARRGGBB */
+MB_API const uint32_t *mb_palette(void);
+/* 0xC000-0xDFFF, 0xFF80-0xFFFE and 0x8000-0x9FFF, size is set to the length */
+MB_API uint8_t *mb_wram(mb_system *gb, size_t *size);
+MB_API uint8_t *mb_hram(mb_system *gb, size_t *size);
+MB_API uint8_t *mb_vram(mb_system *gb, size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
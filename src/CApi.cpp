@@ -0,0 +1,182 @@
+#include "microboy.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "Cartridge.h"
+#include "ObservationPipeline.h"
+#include "ResetPool.h"
+#include "System.h"
+
+static_assert(MB_WIDTH == dmg::WIDTH && MB_HEIGHT == dmg::HEIGHT);
+static_assert(MB_BUTTON_DOWN == 1 << static_cast<int>(JoyPadInput::DOWN));
+static_assert(MB_BUTTON_B == 1 << static_cast<int>(JoyPadInput::B));
+
+struct mb_system {
+    explicit mb_system(RomImage rom) : pool{std::move(rom)} {
+        pool.restore(gb);
+    }
+
+    System gb{};
+    ResetPool pool;
+    std::optional<ObservationPipeline> pipeline{};
+    uint8_t *observation{nullptr};
+};
+
+namespace {
+
+// nothing may throw across the C interface, a rom too short for its header
+// or running out of memory just fails the call
+mb_system *create(RomImage rom) {
+    try {
+        return new mb_system(std::move(rom));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+}
+
+extern "C" {
+
+int mb_api_version(void) {
+    return MB_API_VERSION;
+}
+
+mb_system *mb_create(const char *rom_path) {
+    if (rom_path == nullptr) {
+        return nullptr;
+    }
+    try {
+        RomImage rom = load_rom_image(rom_path);
+        return rom ? create(std::move(rom)) : nullptr;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+mb_system *mb_create_from_memory(const uint8_t *rom, size_t size) {
+    if (rom == nullptr) {
+        return nullptr;
+    }
+    try {
+        return create(std::make_shared<const std::vector<uint8_t>>(rom, rom + size));
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void mb_destroy(mb_system *gb) {
+    delete gb;
+}
+
+int mb_step(mb_system *gb, int frames) {
+    int drawn = 0;
+    for (int i = 0; i < frames; ++i) {
+        drawn += gb->gb.run_frame();
+    }
+    if (drawn > 0 && gb->pipeline) {
+        if (gb->gb.ppu.indexed()) {
+            gb->pipeline->push(gb->gb.ppu.get_shade_buffer());
+        } else {
+            gb->pipeline->push(gb->gb.ppu.get_frame_buffer());
+        }
+        gb->pipeline->write(gb->observation);
+    }
+    return drawn;
+}
+
+void mb_set_input(mb_system *gb, uint8_t buttons) {
+    gb->gb.joypad.set_buttons(buttons);
+}
+
+void mb_set_rendering(mb_system *gb, int enabled) {
+    gb->gb.ppu.set_rendering(enabled != 0);
+}
+
+void mb_set_indexed(mb_system *gb, int enabled) {
+    gb->gb.ppu.set_indexed(enabled != 0);
+}
+
+int mb_save(mb_system *gb) {
+    try {
+        return gb->pool.save(gb->gb);
+    } catch (...) {
+        return -1;
+    }
+}
+
+int mb_save_slot(mb_system *gb, int slot) {
+    if (slot < 0 || slot >= gb->pool.size()) {
+        return -1;
+    }
+    try {
+        gb->pool.save(slot, gb->gb);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int mb_load(mb_system *gb, int slot) {
+    if (slot < 0 || slot >= gb->pool.size()) {
+        return -1;
+    }
+    gb->pool.restore(gb->gb, slot);
+    if (gb->pipeline) {
+        gb->pipeline->clear();
+        gb->pipeline->write(gb->observation);
+    }
+    return 0;
+}
+
+size_t mb_set_observation(mb_system *gb, const mb_observation_config *config, uint8_t *out) {
+    gb->pipeline.reset();
+    gb->observation = nullptr;
+    if (config == nullptr) {
+        return 0;
+    }
+    try {
+        ObservationPipeline pipeline{ObservationConfig{config->crop_x, config->crop_y, config->crop_width,
+            config->crop_height, config->width, config->height, config->stack}};
+        size_t size = pipeline.size();
+        if (out != nullptr) {
+            pipeline.write(out);
+            gb->pipeline.emplace(std::move(pipeline));
+            gb->observation = out;
+        }
+        return size;
+    } catch (...) {
+        return 0;
+    }
+}
+
+const uint32_t *mb_frame_buffer(mb_system *gb) {
+    return gb->gb.ppu.get_frame_buffer();
+}
+
+const uint8_t *mb_shade_buffer(mb_system *gb) {
+    return gb->gb.ppu.get_shade_buffer();
+}
+
+const uint32_t *mb_palette(void) {
+    return gPalette.data();
+}
+
+uint8_t *mb_wram(mb_system *gb, size_t *size) {
+    if (size != nullptr) { *size = 0x2000; }
+    return gb->gb.bus.wram_data();
+}
+
+uint8_t *mb_hram(mb_system *gb, size_t *size) {
+    if (size != nullptr) { *size = 0x7F; }
+    return gb->gb.bus.hram_data();
+}
+
+uint8_t *mb_vram(mb_system *gb, size_t *size) {
+    if (size != nullptr) { *size = 0x2000; }
+    return gb->gb.ppu.vram_data();
+}
+
+}
@@ -25,14 +25,18 @@ CartridgeSettings parse_header(const std::vector<uint8_t> &data) {
 	return cart_settings;
 }
 
-std::unique_ptr<Cartridge> system_load_rom(const std::string &filename) {
+RomImage load_rom_image(const std::string &filename) {
 	std::ifstream rom(filename, std::ios::in | std::ios::binary);
 	if (!rom.is_open()) {
 		return nullptr;
 	}
-	std::vector<uint8_t> rom_data((std::istreambuf_iterator<char>(rom)), std::istreambuf_iterator<char>());
-	//fmt::print("file size: {:#04x}\n", rom_data.size());
-	auto cart_settings = parse_header(rom_data);
+	return std::make_shared<const std::vector<uint8_t>>(
+		std::istreambuf_iterator<char>(rom), std::istreambuf_iterator<char>());
+}
+
+std::unique_ptr<Cartridge> make_cartridge(RomImage rom) {
+	//fmt::print("file size: {:#04x}\n", rom->size());
+	auto cart_settings = parse_header(*rom);
 	//fmt::print("Cartridge Title: {}\n", cart_settings.title);
 	//fmt::print("Cartridge Type: {}\n", cartridge_types[static_cast<uint8_t>(cart_settings.type)]);
 	//fmt::print("Cartridge Rom Size: {}\n", rom_sizes_str[static_cast<uint8_t>(cart_settings.rom_size)]);
@@ -40,8 +44,16 @@ std::unique_ptr<Cartridge> system_load_rom(const std::string &filename) {
 
 	// TODO - create a cart builder
 	switch(cart_settings.type) {
-	case CartridgeType::MBC0: return std::make_unique<Mbc0>(rom_data);
-	case CartridgeType::MBC1: return std::make_unique<Mbc1>(rom_data);
-	default: return std::make_unique<Mbc0>(rom_data);
+	case CartridgeType::MBC0: return std::make_unique<Mbc0>(std::move(rom));
+	case CartridgeType::MBC1: return std::make_unique<Mbc1>(std::move(rom));
+	default: return std::make_unique<Mbc0>(std::move(rom));
+	}
+}
+
+std::unique_ptr<Cartridge> system_load_rom(const std::string &filename) {
+	RomImage rom = load_rom_image(filename);
+	if (!rom) {
+		return nullptr;
 	}
+	return make_cartridge(std::move(rom));
 }
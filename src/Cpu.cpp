@@ -1,104 +1,116 @@
 #include <stdio.h>
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
 #include <fmt/core.h>
 
 #include "Cpu.h"
+#include "FlatBus.h"
 #include "Opcode.h"
+#include "TraceBus.h"
+
+// optional bus features the cpu uses to skip ahead when it is only waiting
+// on the rest of the system
+template <typename Bus>
+concept InterruptTimingBus = requires(Bus &bus, uint16_t addr) {
+	{ bus.cycles_until_interrupt() } -> std::convertible_to<int>;
+	{ bus.cycles_until_change(addr) } -> std::convertible_to<int>;
+};
+
+template <typename Bus>
+concept DirectMemoryBus = requires(Bus &bus, uint16_t addr, uint16_t len) {
+	{ bus.read_ptr(addr, len) } -> std::convertible_to<const uint8_t *>;
+	{ bus.write_ptr(addr, len) } -> std::convertible_to<uint8_t *>;
+};
 
 //-----------------------------------------------------
 // Flags Methods
 //-----------------------------------------------------
-void Flag::from_byte(uint8_t byte) {
-	C = (byte & 0x10) >> 4;
-	H = (byte & 0x20) >> 5;
-	N = (byte & 0x40) >> 6;
-	Z = (byte & 0x80) >> 7;
-	pad = 0;
-}
-uint8_t Flag::to_byte() {
-	uint8_t byte = 0;
-	byte |= C << 4;
-	byte |= H << 5;
-	byte |= N << 6;
-	byte |= Z << 7;
-	return byte;
-}
-
 // flag setting operations
-void Cpu::set_flag_c(bool set) {
-	if (set) {
-		m_flags.C = 1;
-		return;
-	}
-	m_flags.C = 0;
+template <CpuBus Bus>
+void BasicCpu<Bus>::set_flag_c(bool set) {
+	m_flags.set_c(set);
 }
 
-void Cpu::set_flag_h(bool set) {
-	if (set) {
-		m_flags.H = 1;
-		return;
-	}
-	m_flags.H = 0;
+template <CpuBus Bus>
+void BasicCpu<Bus>::set_flag_h(bool set) {
+	m_flags.set_h(set);
 }
 
-void Cpu::set_flag_z(bool set) {
-	if (set) {
-		m_flags.Z = 1;
-		return;
-	}
-	m_flags.Z = 0;
+template <CpuBus Bus>
+void BasicCpu<Bus>::set_flag_z(bool set) {
+	m_flags.set_z(set);
 }
 
-void Cpu::set_flag_n(bool set) {
-	if (set) {
-		m_flags.N = 1;
-		return;
-	}
-	m_flags.N = 0;
+template <CpuBus Bus>
+void BasicCpu<Bus>::set_flag_n(bool set) {
+	m_flags.set_n(set);
 }
 
 
 //-----------------------------------------------------
 // Cpu Methods
 //-----------------------------------------------------
-void Cpu::connect_bus(std::shared_ptr<MemoryBus> bus) {
+template <CpuBus Bus>
+void BasicCpu<Bus>::connect_bus(Bus *bus) {
 	m_bus = bus;
 }
 
-int Cpu::step(int cycles) {
+template <CpuBus Bus>
+void BasicCpu<Bus>::connect_interrupt_observer(InterruptObserver *observer) {
+	m_int_obs = observer;
+}
+
+template <CpuBus Bus>
+int BasicCpu<Bus>::step(int cycles, int max_cycles) {
 	int cycles_taken = 0;
 
 	while (cycles_taken < cycles) {
 		// handle interrupts and halt
-		// interrupt handler
-		if (ime_enable) {
-			switch (ei_delay){
-			case 2:
-				ei_delay = 1;
-				break;
-			case 1:
-				ei_delay = 0;
-				ime_enable = false;
-				IME = true;
-				break;
-			default:
-				break;
-			}
+		if (interrupt_pending()) {
+			cycles_taken += service_interrupt();
 		}
-		cycles_taken += service_interrupt();
 		if (m_halted) {
-			cycles_taken += 4;
+			if constexpr (InterruptTimingBus<Bus>) {
+				// nothing can wake us up before the ppu or timer requests an
+				// interrupt, so jump straight there instead of idling 4 cycles at a time
+				int idle_cycles = std::min(m_bus->cycles_until_interrupt(), max_cycles - cycles_taken);
+				cycles_taken += std::max(4, (idle_cycles + 3) & ~3);
+			} else {
+				cycles_taken += 4;
+			}
 			break;
 		}
-		fetch();
-		cycles_taken += decode();
+		uint16_t pc = m_PC;
+		m_instruction_cycle = m_cycles + cycles_taken;
 		cycles_taken += execute();
+		// a short JR back might be a polling, copy or fill loop. A trace
+		// wants every instruction so loops aren't collapsed while tracing
+		bool is_jr = m_opcode == 0x18 || (m_opcode & 0xE7) == 0x20;
+		if (is_jr && m_trace == nullptr && m_PC < pc && pc - m_PC <= 6) {
+			int skipped = 0;
+			if (m_idle_skip) {
+				skipped = skip_idle_loop(cycles_taken, max_cycles);
+			}
+			if (skipped == 0) {
+				skipped = run_bulk_loop(cycles_taken, max_cycles);
+			}
+			if (skipped > 0) {
+				cycles_taken += skipped;
+				break;
+			}
+		}
 	}
 
+	m_cycles += cycles_taken;
 	return cycles_taken;
 }
 
-void Cpu::reset() {
+template <CpuBus Bus>
+void BasicCpu<Bus>::reset() {
 	m_reg[A] = 0x01;
 	m_flags.from_byte(0xB0);
 	m_reg[B] = 0x00;
@@ -111,20 +123,24 @@ void Cpu::reset() {
 	m_SP = 0xFFFE;
 	m_halted = false;
 	IME = false;
-	ei_delay = 0;
+	m_cycles = 0;
+	m_debug_break = false;
 }
 
-uint8_t Cpu::read_byte(RegisterName8Bit reg) {
+template <CpuBus Bus>
+uint8_t BasicCpu<Bus>::read_byte(RegisterName8Bit reg) {
 	if (reg == F) return m_flags.to_byte();
 	return m_reg[reg];
 }
 
-void Cpu::write_byte(RegisterName8Bit reg, uint8_t value) {
+template <CpuBus Bus>
+void BasicCpu<Bus>::write_byte(RegisterName8Bit reg, uint8_t value) {
 	if (reg == F) { m_flags.from_byte(value & 0xF0); return; }
 	m_reg[reg] = value;
 }
 
-uint16_t Cpu::read_word(RegisterName16Bit reg) {
+template <CpuBus Bus>
+uint16_t BasicCpu<Bus>::read_word(RegisterName16Bit reg) {
 	switch (reg) {
 	case BC: return m_reg[B] << 8 | m_reg[C];
 	case DE: return m_reg[D] << 8 | m_reg[E];
@@ -136,7 +152,8 @@ uint16_t Cpu::read_word(RegisterName16Bit reg) {
 	}
 }
 
-void Cpu::write_word(RegisterName16Bit reg, uint16_t value) {
+template <CpuBus Bus>
+void BasicCpu<Bus>::write_word(RegisterName16Bit reg, uint16_t value) {
 	if (reg == SP) { m_SP = value;  return; }
 	switch (reg) {
 	case BC: { m_reg[B] = (value >> 8) & 0xFF; m_reg[C] = value & 0xFF; return; }
@@ -148,96 +165,199 @@ void Cpu::write_word(RegisterName16Bit reg, uint16_t value) {
 	}
 }
 
-inline void Cpu::fetch() {
-	m_opcode = m_bus->read_byte(m_PC);
-	//fmt::print("PC: {:#04x} Opcode: {:#02x}: {}\n", m_PC, m_opcode, CYCLE_TABLE_DEBUG[m_opcode].name);
+// handle any pending interrupts, only called when IE & IF is non-zero
+template <CpuBus Bus>
+int BasicCpu<Bus>::service_interrupt() {
+	// ISR vectors
+	static uint8_t isr_vectors[5]{ 0x40, 0x48, 0x50, 0x58, 0x60 };
+
+	// a pending interrupt always ends halt, even with IME off
+	// TODO halt bug - causes prev instr to be read twice
+	m_halted = false;
+
+	// Quit out early if IME is diabled
+	if (IME == false) { return 0; }
+
+	// the lowest set bit is the highest priority interrupt
+	InterruptSource src = m_int_obs->next_pending();
+	// ack interrupt by disabling IME and clearing the request bit in IF
+	IME = false;
+	m_int_obs->acknowledge(src);
+	// call the handler
+	opcode_call(isr_vectors[static_cast<uint8_t>(src)]);
+	return 20; // isr comsumes 5 M cycles
 }
 
-int Cpu::decode() {
-	// decode the instruction and set the instruction to ease execution
-	int cycles = 0;
-	uint16_t inc_pc = 0;
-	if (m_opcode == 0xcb) {
-		++m_PC;
-		m_opcode = m_bus->read_byte(m_PC);
-		//fmt::print("0xCB prefixed {:#02x}: {}\n", m_opcode, CYCLE_TABLE_DEBUG_CB[m_opcode].name);
-		inc_pc = CYCLE_TABLE_DEBUG_CB[m_opcode].len-1;
-		//cycles = CYCLE_TABLE_DEBUG_CB[m_opcode].cycles;
-		m_is_cb = true;
+// Recognizes the loop
+//     LDH A,(n)  ; n is LY, STAT, DIV, TIMA or SC
+//     CP u8 / AND u8 / BIT b,A
+//     JR cc,-6
+// right after its JR was taken. Until the polled register changes every
+// iteration reads the same value and takes the same branch, so whole
+// iterations can be skipped without touching any cpu state. The register
+// may have changed since the LDH when the iteration was split across steps,
+// then the loop runs normally. Never skips past the next interrupt request
+// or max_cycles.
+template <CpuBus Bus>
+int BasicCpu<Bus>::skip_idle_loop(int cycles_taken, int max_cycles) {
+	if constexpr (!InterruptTimingBus<Bus>) {
+		return 0;
 	} else {
-		inc_pc = CYCLE_TABLE_DEBUG[m_opcode].len;
-		//cycles = CYCLE_TABLE_DEBUG[m_opcode].cycles;
-	}
+		if (interrupt_pending()) { return 0; }
 
-	// Fetched data, registers and immediates to use
-	m_r1 = static_cast<RegisterName8Bit>((m_opcode >> 3) & 0x7);
-	m_r2 = static_cast<RegisterName8Bit>(m_opcode & 0x7);
-	m_r16 = static_cast<RegisterName16Bit>((m_opcode >> 4) & 7);
-	imm_u8 = m_bus->read_byte(m_PC + 1);
-	imm_u16 = m_bus->read_word(m_PC + 1);
+		uint16_t loop = m_PC;
+		if (m_bus->read_byte(loop) != 0xF0) { return 0; }
+		uint8_t cmp = m_bus->read_byte(loop + 2);
+		uint8_t operand = m_bus->read_byte(loop + 3);
+		int loop_cycles = CYCLE_TABLE_DEBUG[0xF0].cycles;
+		if (cmp == 0xCB) {
+			if ((operand & 0xC7) != 0x47) { return 0; }
+			loop_cycles += CYCLE_TABLE_DEBUG_CB[operand].cycles;
+		} else if (cmp == 0xFE || cmp == 0xE6) {
+			loop_cycles += CYCLE_TABLE_DEBUG[cmp].cycles;
+		} else {
+			return 0;
+		}
+		uint8_t jr = m_bus->read_byte(loop + 4);
+		if ((jr & 0xE7) != 0x20 || m_bus->read_byte(loop + 5) != 0xFA) { return 0; }
+		loop_cycles += CYCLE_TABLE_DEBUG[jr].cycles_extra;
 
-	// Increment the PC to the next instruction
-	m_PC += inc_pc;
+		uint16_t reg = IO_BASE + m_bus->read_byte(loop + 1);
+		int until_change = m_bus->cycles_until_change(reg);
+		if (until_change <= 0) { return 0; }
 
-	return cycles;
-}
+		// the next LDH has to see what the last one did, A still holds that
+		// value, or for AND the value masked
+		uint8_t value = m_bus->read_byte(reg);
+		bool unchanged = false;
+		if (cmp == 0xCB) {
+			int bit = (operand >> 3) & 7;
+			unchanged = ((value ^ m_reg[A]) >> bit & 1) == 0;
+		} else if (cmp == 0xE6) {
+			unchanged = (value & operand) == m_reg[A];
+		} else {
+			unchanged = value == m_reg[A];
+		}
+		if (!unchanged) { return 0; }
+
+		// the ppu and timer haven't been stepped for this step's cycles yet
+		int until_interrupt = std::min(m_bus->cycles_until_interrupt(), max_cycles) - cycles_taken;
+		int wait = std::min(until_change - cycles_taken, until_interrupt);
+		int iterations = std::min((wait + loop_cycles - 1) / loop_cycles, until_interrupt / loop_cycles);
+		if (iterations <= 0) { return 0; }
 
-// Return any extra cycles taken due to memory read/writes
-int Cpu::execute() {
-	if (m_is_cb) {
-		m_is_cb = false;
-		return handle_cb_prefix();
+		int skipped = iterations * loop_cycles;
+		++m_idle_loops_skipped;
+		m_idle_cycles_skipped += skipped;
+		return skipped;
 	}
-	return handle_opcode();
 }
 
-// handle any pending interrupts
-int Cpu::service_interrupt() {
-	// ISR vectors
-	static uint8_t isr_vectors[5]{ 0x40, 0x48, 0x50, 0x58, 0x60 };
+// Recognizes the copy and fill loops used to move tiles around and clear
+// ram, right after their JR was taken, and runs the remaining iterations as
+// a single memcpy/memset with the same registers, flags and cycle count:
+//     copy16: LD A,(HL+); LD (DE),A; INC DE; DEC BC; LD A,B; OR C; JR NZ,-8
+//     copy8:  LD A,(HL+); LD (DE),A; INC DE; DEC r; JR NZ,-6
+//     fill8:  LD (HL+),A; DEC r; JR NZ,-4
+//     fill16: LD (HL),u8; INC HL; DEC BC; LD A,B; OR C; JR NZ,-8
+// r is B or C. Only loops running from rom over plain ram/rom are handled,
+// anything touching IO, OAM, cartridge ram or locked VRAM runs normally.
+// Stops short of the next interrupt request so it is serviced on time, and
+// of max_cycles.
+template <CpuBus Bus>
+int BasicCpu<Bus>::run_bulk_loop(int cycles_taken, int max_cycles) {
+	if constexpr (!(InterruptTimingBus<Bus> && DirectMemoryBus<Bus>)) {
+		return 0;
+	} else {
+		static constexpr uint8_t COPY16[]{ 0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8 };
+		static constexpr uint8_t COPY8[]{ 0x2A, 0x12, 0x13 };
+		static constexpr uint8_t FILL16[]{ 0x23, 0x0B, 0x78, 0xB1, 0x20, 0xF8 };
+		auto is_dec_counter = [](uint8_t op) { return op == 0x05 || op == 0x0D; };
 
-	uint8_t IE = m_bus->read_byte(IE_ADDR);
-	uint8_t IF = m_bus->read_byte(IF_ADDR);
-	// Exit halt if IF & IE are non-zero NOTE: TODO emulate halt bug
-	if (IE && IF) {
-		// in either case if we have a pending interrupt
-		// we leave halt
-		if (IME == false) {
-			// TODO halt bug
-			// causes prev instr to be read twice
+		uint16_t loop = m_PC;
+		if (loop > ROM_END || interrupt_pending()) { return 0; }
+		const uint8_t *code = m_bus->read_ptr(loop, 8);
+		if (!code) { return 0; }
+
+		bool copy = false;
+		bool wide = false;
+		int len = 0;
+		uint8_t fill = m_reg[A];
+		RegisterName8Bit counter = C;
+		if (std::equal(std::begin(COPY16), std::end(COPY16), code)) {
+			copy = wide = true;
+			len = 8;
+		} else if (std::equal(std::begin(COPY8), std::end(COPY8), code) && is_dec_counter(code[3])
+			&& code[4] == 0x20 && code[5] == 0xFA) {
+			copy = true;
+			counter = code[3] == 0x05 ? B : C;
+			len = 6;
+		} else if (code[0] == 0x22 && is_dec_counter(code[1]) && code[2] == 0x20 && code[3] == 0xFC) {
+			counter = code[1] == 0x05 ? B : C;
+			len = 4;
+		} else if (code[0] == 0x36 && std::equal(std::begin(FILL16), std::end(FILL16), code + 2)) {
+			fill = code[1];
+			wide = true;
+			len = 8;
+		} else {
+			return 0;
 		}
-		m_halted = false;
-	}
 
-	// Quit out early if IME is diabled
-	if (IME == false) { return 0; }
+		// cycles per iteration with the JR taken and not taken
+		int body_cycles = 0;
+		for (int i = 0; i < len - 2; i += CYCLE_TABLE_DEBUG[code[i]].len) {
+			body_cycles += CYCLE_TABLE_DEBUG[code[i]].cycles;
+		}
+		int taken_cycles = body_cycles + CYCLE_TABLE_DEBUG[0x20].cycles_extra;
+		int last_cycles = body_cycles + CYCLE_TABLE_DEBUG[0x20].cycles;
+
+		// the JR was taken so the counter is non zero, that many iterations are left
+		int remaining = wide ? read_word(BC) : m_reg[counter];
+		int iterations = remaining;
+		int until_interrupt = std::min(m_bus->cycles_until_interrupt(), max_cycles) - cycles_taken;
+		if ((remaining - 1) * taken_cycles + last_cycles > until_interrupt) {
+			iterations = until_interrupt / taken_cycles;
+		}
+		if (iterations <= 0) { return 0; }
+
+		uint16_t hl = read_word(HL);
+		uint16_t dst = copy ? read_word(DE) : hl;
+		uint8_t *out = m_bus->write_ptr(dst, iterations);
+		if (!out) { return 0; }
+		if (copy) {
+			const uint8_t *in = m_bus->read_ptr(hl, iterations);
+			// byte by byte copies over overlapping ranges don't behave like memcpy
+			if (!in || (std::less<>{}(in, out + iterations) && std::less<>{}(out, in + iterations))) { return 0; }
+			std::memcpy(out, in, iterations);
+			write_word(DE, dst + iterations);
+		} else {
+			std::memset(out, fill, iterations);
+		}
+		write_word(HL, hl + iterations);
 
-	// check each interrupt bit from highest priority to lowest
-	for (int i = 0; i < 5; ++i) {
-		// check IME and IF and IE bits
-		if (IME &&
-		   ((IE >> i) & 0x1) &
-		   ((IF >> i) & 0x1))
-		{
-			// fmt::print("IF: {:4x}, IE: {:4x}\n", IF, IE);
-			// fmt::print("servicing interrupt: {}\n", i);
-			// IE = m_bus->read_byte(IE_ADDR);
-			// IF = m_bus->read_byte(IF_ADDR);
-			// ack interrupt by disabling IME
-			IME = false;
-			// ack interrupt request bit in IF
-			IF &= ~(0x1 << i);
-			// write IF back into memory
-			m_bus->write_byte(IF_ADDR, IF);
-			// call the handler
-			opcode_call(isr_vectors[i]);
-			return 20; // isr comsumes 5 M cycles
+		remaining -= iterations;
+		if (wide) {
+			// LD A,B; OR C
+			write_word(BC, remaining);
+			m_reg[A] = m_reg[B] | m_reg[C];
+			m_flags.from_byte(m_reg[A] == 0 ? 0x80 : 0x00);
+		} else {
+			// DEC r leaves carry alone
+			m_reg[counter] = remaining;
+			if (copy) { m_reg[A] = out[iterations - 1]; }
+			m_flags.set_lazy(FlagOp::DEC, remaining + 1, 1, remaining, m_flags.c());
 		}
+
+		if (remaining == 0) {
+			m_PC = loop + len;
+			return (iterations - 1) * taken_cycles + last_cycles;
+		}
+		return iterations * taken_cycles;
 	}
-	return 0;
 }
 
-void debug_print(Cpu& cpu) {
+template <CpuBus Bus>
+void debug_print(BasicCpu<Bus> &cpu) {
 	printf("A: %02X ", cpu.m_reg[7]);
 	printf("F: %02X ", cpu.m_flags.to_byte());
 	printf("B: %02X ", cpu.m_reg[0]);
@@ -251,3 +371,11 @@ void debug_print(Cpu& cpu) {
 	uint16_t pc = cpu.m_PC;
 	printf("(%02X %02X %02X %02X)\n", cpu.m_bus->read_byte(pc), cpu.m_bus->read_byte(pc + 1), cpu.m_bus->read_byte(pc + 2), cpu.m_bus->read_byte(pc + 3));
 }
+
+// Opcode.cpp instantiates the members it defines
+template class BasicCpu<MemoryBus>;
+template class BasicCpu<FlatBus>;
+template class BasicCpu<TraceBus>;
+template void debug_print(BasicCpu<MemoryBus> &cpu);
+template void debug_print(BasicCpu<FlatBus> &cpu);
+template void debug_print(BasicCpu<TraceBus> &cpu);
@@ -0,0 +1,67 @@
+#include "Disassembler.h"
+
+#include <string_view>
+
+#include "Opcode.h"
+
+namespace {
+
+// appends to a fixed buffer, dropping whatever doesn't fit
+struct TextWriter {
+	char *out;
+	size_t size;
+	size_t pos{0};
+
+	void put(char c) {
+		if (pos + 1 < size) { out[pos++] = c; }
+	}
+	void put_hex(unsigned value, int digits) {
+		static constexpr char HEX[] = "0123456789ABCDEF";
+		put('$');
+		for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+			put(HEX[(value >> shift) & 0xF]);
+		}
+	}
+	void finish() {
+		if (size > 0) { out[pos < size ? pos : size - 1] = '\0'; }
+	}
+};
+
+}
+
+int disassemble(const uint8_t *bytes, uint16_t pc, char *out, size_t size) {
+	bool is_cb = bytes[0] == 0xCB;
+	const Opcode &opcode = is_cb ? CYCLE_TABLE_DEBUG_CB[bytes[1]] : CYCLE_TABLE_DEBUG[bytes[0]];
+	// STOP is listed with a length of 0 since the cpu stays on it
+	int len = opcode.len == 0 ? 1 : opcode.len;
+	uint8_t imm_u8 = bytes[1];
+	uint16_t imm_u16 = bytes[1] | (bytes[2] << 8);
+
+	// the names spell out their operands as u8, u16 and i8
+	std::string_view name = opcode.name;
+	TextWriter writer{out, size};
+	for (size_t i = 0; i < name.size(); ++i) {
+		std::string_view rest = name.substr(i);
+		if (rest.starts_with("u16")) {
+			writer.put_hex(imm_u16, 4);
+			i += 2;
+		} else if (rest.starts_with("u8")) {
+			writer.put_hex(imm_u8, 2);
+			i += 1;
+		} else if (rest.starts_with("i8") || rest.starts_with("+i8")) {
+			int8_t offset = static_cast<int8_t>(imm_u8);
+			if (name.starts_with("JR")) {
+				// show where the jump lands rather than the offset
+				writer.put_hex(static_cast<uint16_t>(pc + len + offset), 4);
+			} else {
+				writer.put(offset < 0 ? '-' : '+');
+				writer.put_hex(offset < 0 ? -offset : offset, 2);
+			}
+			i += rest[0] == '+' ? 2 : 1;
+		} else {
+			writer.put(name[i]);
+		}
+	}
+	writer.finish();
+	return len;
+}
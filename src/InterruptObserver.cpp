@@ -1,6 +1,7 @@
 #include <memory>
 // #include <fmt/core.h>
 #include "InterruptObserver.h"
+#include "MemoryBus.h"
 
 constexpr int NUM_INTERRUPTS = 5;
 static std::string interrupt_source_str[NUM_INTERRUPTS] = {
@@ -14,13 +15,22 @@ static std::string interrupt_source_str[NUM_INTERRUPTS] = {
 void InterruptObserver::reset() { 
     m_if = 0xE1; 
     m_ie = 0x00;
+    update_pending();
 }
 
 void InterruptObserver::schedule_interrupt(InterruptSource src) {
     m_if |= 1 << static_cast<uint8_t>(src);
+    update_pending();
     // fmt::print("Requesting interrupt: {}\n", interrupt_source_str[static_cast<size_t>(src)]);
 }
 
+void InterruptObserver::register_io_handlers(MemoryBus &bus) {
+    bus.register_io_handler(IF_ADDR, IoHandler{
+        [](void *ctx, uint16_t addr) { return static_cast<InterruptObserver *>(ctx)->read_byte(addr); },
+        [](void *ctx, uint16_t addr, uint8_t val) { static_cast<InterruptObserver *>(ctx)->write_byte(addr, val); },
+        this});
+}
+
 uint8_t InterruptObserver::read_byte(uint16_t addr) {
     switch (addr) {
         case IE_ADDR:
@@ -40,4 +50,9 @@ void InterruptObserver::write_byte(uint16_t addr, uint8_t val) {
             m_if = val & 0x1F;
             break;
     }
+    update_pending();
+}
+
+void InterruptObserver::acknowledge(InterruptSource src) {
+    write_byte(IF_ADDR, m_if & ~(1 << static_cast<uint8_t>(src)));
 }
@@ -1,8 +1,10 @@
 #include <memory>
 
 #include "common.h"
+#include "HostInput.h"
 #include "JoyPad.h"
 #include "InterruptObserver.h"
+#include "MemoryBus.h"
 
 void JoyPad::reset() { 
     m_joyp = 0xCF; 
@@ -10,92 +12,66 @@ void JoyPad::reset() {
     m_dir_button = 0xFF;
 }
 
-void JoyPad::select_dir() { 
-    m_joyp = set_bit(m_joyp, 5);
-    m_joyp = clear_bit(m_joyp, 4);
+void JoyPad::handle_press(JoyPadInput input){
+    set_buttons(buttons() | 1 << static_cast<int>(input));
 }
 
-void JoyPad::select_action() { 
-    m_joyp = set_bit(m_joyp, 4);
-    m_joyp = clear_bit(m_joyp, 5);
+void JoyPad::handle_release(JoyPadInput input){
+    set_buttons(buttons() & ~(1 << static_cast<int>(input)));
 }
 
-void JoyPad::handle_press(JoyPadInput input){
-    switch(input) {
-    case JoyPadInput::DOWN:
-        m_dir_button = clear_bit(m_dir_button, 3);
-        select_dir();
-        break;
-    case JoyPadInput::UP:
-        m_dir_button = clear_bit(m_dir_button, 2);
-        select_dir();
-        break;
-    case JoyPadInput::LEFT:
-        m_dir_button = clear_bit(m_dir_button, 1);
-        select_dir();
-        break;
-    case JoyPadInput::RIGHT:
-        m_dir_button = clear_bit(m_dir_button, 0);
-        select_dir();
-        break;
-    case JoyPadInput::START:
-        m_action_button = clear_bit(m_action_button, 3);
-        select_action();
-        break;
-    case JoyPadInput::SELECT:
-        m_action_button = clear_bit(m_action_button, 2);
-        select_action();
-        break;
-    case JoyPadInput::A:
-        m_action_button = clear_bit(m_action_button, 1);
-        select_action();
-        break;
-    case JoyPadInput::B:
-        m_action_button = clear_bit(m_action_button, 0);
-        select_action();
-        break;
+uint8_t JoyPad::buttons() const {
+    // DOWN, UP, LEFT, RIGHT are bits 3-0 of the d-pad nibble, START, SELECT,
+    // A, B bits 3-0 of the action nibble, both active low
+    uint8_t pressed = 0;
+    for (int i = 0; i < 4; ++i) {
+        pressed |= !is_bit_set(m_dir_button, 3 - i) << i;
+        pressed |= !is_bit_set(m_action_button, 3 - i) << (i + 4);
     }
-    m_int_obs->schedule_interrupt(InterruptSource::JOYPAD);
+    return pressed;
 }
 
-void JoyPad::handle_release(JoyPadInput input){
-    switch(input) {
-    case JoyPadInput::DOWN:
-        m_dir_button = set_bit(m_dir_button, 3);
-        m_joyp = set_bit(m_joyp, 4);
-        break;
-    case JoyPadInput::UP:
-        m_dir_button = set_bit(m_dir_button, 2);
-        m_joyp = set_bit(m_joyp, 4);
-        break;
-    case JoyPadInput::LEFT:
-        m_dir_button = set_bit(m_dir_button, 1);
-        m_joyp = set_bit(m_joyp, 4);
-        break;
-    case JoyPadInput::RIGHT:
-        m_dir_button = set_bit(m_dir_button, 0);
-        m_joyp = set_bit(m_joyp, 4);
-        break;
-    case JoyPadInput::START:
-        m_action_button = set_bit(m_action_button, 3);
-        m_joyp = set_bit(m_joyp, 5);
-        break;
-    case JoyPadInput::SELECT:
-        m_action_button = set_bit(m_action_button, 2);
-        m_joyp = set_bit(m_joyp, 5);
-        break;
-    case JoyPadInput::A:
-        m_action_button = set_bit(m_action_button, 1);
-        m_joyp = set_bit(m_joyp, 5);
-        break;
-    case JoyPadInput::B:
-        m_action_button = set_bit(m_action_button, 0);
-        m_joyp = set_bit(m_joyp, 5);
-        break;
+void JoyPad::set_buttons(uint8_t pressed) {
+    // only the button lines change, which group JOYP shows stays whatever
+    // the game selected
+    bool newly_pressed = (pressed & ~buttons()) != 0;
+    m_dir_button = 0xF0;
+    m_action_button = 0xF0;
+    for (int i = 0; i < 4; ++i) {
+        m_dir_button |= !is_bit_set(pressed, i) << (3 - i);
+        m_action_button |= !is_bit_set(pressed, i + 4) << (3 - i);
+    }
+    if (newly_pressed) {
+        m_int_obs->schedule_interrupt(InterruptSource::JOYPAD);
     }
 }
 
+void JoyPad::start_frame() {
+    // a game that didn't read JOYP last frame may be halted waiting for the
+    // joypad interrupt, it gets the buttons now
+    if (m_poll_pending) {
+        poll_host();
+    }
+    m_poll_pending = m_host != nullptr;
+}
+
+void JoyPad::poll_host() {
+    m_poll_pending = false;
+    set_buttons(m_host->sample());
+}
+
+void JoyPad::register_io_handlers(MemoryBus &bus) {
+    bus.register_io_handler(JOYP_ADDR, IoHandler{
+        [](void *ctx, uint16_t) { return static_cast<JoyPad *>(ctx)->read_byte(); },
+        [](void *ctx, uint16_t, uint8_t val) { static_cast<JoyPad *>(ctx)->write_byte(val); },
+        this});
+}
+
 uint8_t JoyPad::read_byte() {
+    if (m_poll_pending) {
+        // as late as possible, the game is looking at the buttons right now
+        poll_host();
+    }
     // check bits 4 and 5:
     uint8_t data = 0xFF;
     switch (m_joyp & 0x30) {
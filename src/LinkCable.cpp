@@ -0,0 +1,78 @@
+#include "LinkCable.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "System.h"
+
+LinkCable::LinkCable(System &left, System &right)
+    : m_systems{&left, &right} {
+    for (int side = 0; side < 2; ++side) {
+        m_ends[side].cable = this;
+        m_ends[side].side = side;
+        m_base[side] = m_systems[side]->cpu.cycles();
+        m_systems[side]->serial.connect_sink(&m_ends[side]);
+    }
+}
+
+LinkCable::~LinkCable() {
+    for (System *system : m_systems) {
+        system->serial.connect_sink(nullptr);
+        system->serial.set_external_clock_horizon(std::numeric_limits<int>::max());
+    }
+}
+
+uint8_t LinkCable::End::transfer(uint8_t out) {
+    // the other side only shifts when it asked for a transfer itself
+    Serial &other = cable->m_systems[1 - side]->serial;
+    if (!other.waiting_for_clock()) {
+        return 0xFF;
+    }
+    return other.clock_in(out);
+}
+
+uint64_t LinkCable::side_cycles(int side) const {
+    return m_systems[side]->cpu.cycles() - m_base[side];
+}
+
+bool LinkCable::run_frame() {
+    return run(dmg::CYCLES_PER_FRAME);
+}
+
+bool LinkCable::run(int cycles) {
+    bool frame_done = false;
+    uint64_t end = m_cycle + cycles;
+    while (m_cycle < end) {
+        // the slice ends at the next transfer completion
+        uint64_t slice_end = std::min<uint64_t>(end, m_cycle + LINK_MAX_SLICE);
+        bool completes[2]{};
+        for (int side = 0; side < 2; ++side) {
+            const Serial &serial = m_systems[side]->serial;
+            if (serial.transferring()) {
+                uint64_t done = side_cycles(side) + serial.cycles_until_sc_change();
+                slice_end = std::min(slice_end, std::max(done, m_cycle + 1));
+            }
+        }
+        for (int side = 0; side < 2; ++side) {
+            const Serial &serial = m_systems[side]->serial;
+            completes[side] = serial.transferring()
+                && side_cycles(side) + serial.cycles_until_sc_change() <= slice_end;
+        }
+
+        // a side waiting on the external clock must not sleep past slice_end,
+        // and has to get there before the other side completes the transfer
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int side = 0; side < 2; ++side) {
+                if (completes[side] != (pass == 1)) {
+                    continue;
+                }
+                System &system = *m_systems[side];
+                int64_t remaining = static_cast<int64_t>(slice_end) - static_cast<int64_t>(side_cycles(side));
+                system.serial.set_external_clock_horizon(static_cast<int>(std::max<int64_t>(0, remaining)));
+                frame_done |= system.run_until(m_base[side] + slice_end);
+            }
+        }
+        m_cycle = slice_end;
+    }
+    return frame_done;
+}
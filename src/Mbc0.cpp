@@ -2,12 +2,18 @@
 
 uint8_t Mbc0::read_byte(uint16_t addr) {
 	// for MBC0 we don't need to do any bank switching
-	// TODO may need to check whether game tries to read from external ram which does not exist here
-	return rom_data[addr];
+	if (addr >= 0xA000) { return ram_data[addr - 0xA000]; }
+	return (*rom_data)[addr];
+}
+
+const uint8_t *Mbc0::read_ptr(uint16_t addr, uint16_t len) {
+	if (addr >= 0xA000 || addr + len > rom_data->size()) {
+		return nullptr;
+	}
+	return &(*rom_data)[addr];
 }
 
 void Mbc0::write_byte(uint16_t addr, uint8_t value) {
-	// for MBC0 we don't need to do any bank switching
-	// TODO may need to check whether game tries to read from external ram which does not exist here
-	rom_data[addr] = value;
+	// for MBC0 we don't need to do any bank switching, the rom is read only
+	if (addr >= 0xA000) { ram_data[addr - 0xA000] = value; }
 }
@@ -15,20 +15,23 @@ const uint16_t ROM_REG_END 	= 0x3FFF;
 const uint16_t RAM_REG_BASE = 0x0000;
 const uint16_t RAM_REG_END 	= 0x1FFF;
 
-Mbc1::Mbc1(std::vector<uint8_t> data) 
-    : rom_bank_sel(1), ram_bank_sel{1}, ram_enabled{false}, rom_data{data}, ram_data{} 
+Mbc1::Mbc1(RomImage data) 
+    : rom_bank_sel(1), ram_bank_sel{1}, ram_enabled{false}, rom_data{std::move(data)}, ram_data{} 
 {}
 
-uint8_t Mbc1::read_byte(uint16_t addr) {
-	// rom 
+size_t Mbc1::rom_offset(uint16_t addr) {
 	// Bank 0 0x0000 - 0x3FFF
 	if (addr >= BANK1_BASE && addr <= BANK1_END) {
-		return rom_data[addr];
+		return addr;
 	}
-
 	// Bank 0x1-0x7F - 0x4000 - 0x7FFF
-	else if (addr >= BANK2_BASE && addr <= BANK2_END) {
-		return rom_data[addr + (BANK2_BASE * rom_bank_sel)];
+	return addr + (BANK2_BASE * rom_bank_sel);
+}
+
+uint8_t Mbc1::read_byte(uint16_t addr) {
+	// rom 
+	if (addr >= BANK1_BASE && addr <= BANK2_END) {
+		return (*rom_data)[rom_offset(addr)];
 	}
 
 	// RAM access
@@ -40,6 +43,21 @@ uint8_t Mbc1::read_byte(uint16_t addr) {
 	return 0xFF;
 }
 
+const uint8_t *Mbc1::read_ptr(uint16_t addr, uint16_t len) {
+	uint32_t last = addr + len - 1;
+	// the range has to stay inside one bank
+	bool in_bank1 = addr >= BANK1_BASE && last <= BANK1_END;
+	bool in_bank2 = addr >= BANK2_BASE && last <= BANK2_END;
+	if (!in_bank1 && !in_bank2) {
+		return nullptr;
+	}
+	size_t offset = rom_offset(addr);
+	if (offset + len > rom_data->size()) {
+		return nullptr;
+	}
+	return &(*rom_data)[offset];
+}
+
 void Mbc1::write_byte(uint16_t addr, uint8_t value) {
 	// when writing to rom we access MBC registers
 	if (addr >= RAM_EN_BASE && addr <= RAM_EN_END) {
@@ -1,15 +1,57 @@
 // #include <fmt/core.h>
+#include <algorithm>
 #include "InterruptObserver.h"
 #include "JoyPad.h"
 #include "Lcd.h"
 #include "MemoryBus.h"
 #include "Ppu.h"
+#include "Serial.h"
 #include "Timer.h"
 
 MemoryBus::MemoryBus() 
-    : wram(0x2000, 0), IO(0x80, 0), hram(0x7F, 0),
+    : wram(0x2000, 0), IO(IO_REGISTER_COUNT, 0), hram(0x7F, 0),
     cart{nullptr}, m_joypad{nullptr}, m_timer{nullptr}, m_int_observer{nullptr}
-{}
+{
+    init_io_handlers();
+}
+
+MemoryBus::MemoryBus(const MemoryBus &other)
+    : wram(other.wram), IO(other.IO), hram(other.hram),
+    cart{other.cart ? other.cart->clone() : nullptr},
+    m_joypad{other.m_joypad}, m_timer{other.m_timer}, m_int_observer{other.m_int_observer}, m_ppu{other.m_ppu},
+    m_serial{other.m_serial}
+{
+    init_io_handlers();
+}
+
+MemoryBus &MemoryBus::operator=(const MemoryBus &other) {
+    if (this == &other) {
+        return *this;
+    }
+    wram = other.wram;
+    IO = other.IO;
+    hram = other.hram;
+    // snapshots are restored over and over, keep the cartridge's buffers
+    if (!(cart && other.cart && cart->assign(*other.cart))) {
+        cart = other.cart ? other.cart->clone() : nullptr;
+    }
+    m_joypad = other.m_joypad;
+    m_timer = other.m_timer;
+    m_int_observer = other.m_int_observer;
+    m_ppu = other.m_ppu;
+    m_serial = other.m_serial;
+    init_io_handlers();
+    return *this;
+}
+
+void MemoryBus::init_io_handlers() {
+    // registers nobody claims are plain bytes
+    for (int i = 0; i < IO_REGISTER_COUNT; ++i) {
+        m_io_handlers[i] = io_plain_register(&IO[i]);
+    }
+    // KEY1 - used to switch speed in CGB mode, stubbed to 0xFF
+    register_io_handler(KEY1_ADDR, IoHandler{io_read_open_bus, io_write_ignore, nullptr});
+}
 
 void MemoryBus::reset() {
     cart = nullptr;
@@ -17,11 +59,9 @@ void MemoryBus::reset() {
     m_int_observer->reset();
     m_timer->reset();
     m_ppu->reset();
+    m_serial->reset();
 
     // All hardware registers at PC 0x100
-    // Serial
-    IO[SB_ADDR - IO_BASE] 	= 0x00; // SB
-    IO[SC_ADDR - IO_BASE] 	= 0x7E; // SC
     // Skipping sound registers
 }
 
@@ -29,171 +69,91 @@ void MemoryBus::load_cart(std::unique_ptr<Cartridge> c) {
     cart = std::move(c);
 }
 
-void MemoryBus::connect_interrupt_observer(std::shared_ptr<InterruptObserver> observer) {
+void MemoryBus::connect_interrupt_observer(InterruptObserver *observer) {
     m_int_observer = observer;
+    m_int_observer->register_io_handlers(*this);
 }
 
-void MemoryBus::connect_joypad(std::shared_ptr<JoyPad> joypad) { 
+void MemoryBus::connect_joypad(JoyPad *joypad) { 
     m_joypad = joypad;
+    m_joypad->register_io_handlers(*this);
 }
 
-void MemoryBus::connect_ppu(std::shared_ptr<Ppu> ppu) {
+void MemoryBus::connect_ppu(Ppu *ppu) {
     m_ppu = ppu;
+    m_ppu->register_io_handlers(*this);
+}
+
+void MemoryBus::connect_serial(Serial *serial) {
+    m_serial = serial;
+    m_serial->register_io_handlers(*this);
 }
 
-void MemoryBus::connect_timer(std::shared_ptr<Timer> timer) {
+void MemoryBus::connect_timer(Timer *timer) {
     m_timer = timer;
+    m_timer->register_io_handlers(*this);
 }
 
-uint8_t MemoryBus::read_byte(uint16_t addr) {
-    if (addr >= ROM_BASE && addr <= ROM_END) {
-        return cart->read_byte(addr);
-    }
-    else if (addr >= EXRAM_BASE && addr <= EXRAM_END) {
-        return cart->read_byte(addr);
-    }
-    else if (addr >= VRAM_BASE && addr <= VRAM_END) {
-        return m_ppu->read_byte(addr);
-    }
-    else if (addr >= WRAM_BASE && addr <= WRAM_END) {
-        return wram[addr - WRAM_BASE];
+void MemoryBus::register_io_handler(uint16_t addr, IoHandler handler) {
+    m_io_handlers[addr & 0x7F] = handler;
+}
+
+
+int MemoryBus::cycles_until_interrupt() {
+    return std::min({m_ppu->cycles_until_interrupt(), m_timer->cycles_until_interrupt(),
+        m_serial->cycles_until_interrupt()});
+}
+
+int MemoryBus::cycles_until_change(uint16_t addr) {
+    switch (addr) {
+    case LY_ADDR:
+        return m_ppu->cycles_until_ly_change();
+    case STAT_ADDR:
+        return m_ppu->cycles_until_mode_change();
+    case DIV_ADDR:
+        return m_timer->cycles_until_div_change();
+    case TIMA_ADDR:
+        return m_timer->cycles_until_tima_change();
+    case SC_ADDR:
+        return m_serial->cycles_until_sc_change();
+    default:
+        return 0;
     }
-    else if (addr >= ECHO_BASE && addr <= ECHO_END) {
-        return wram[addr - ECHO_BASE];
+}
+
+const uint8_t *MemoryBus::read_ptr(uint16_t addr, uint16_t len) {
+    uint32_t last = addr + len - 1;
+    if (last <= ROM_END) {
+        return cart->read_ptr(addr, len);
     }
-    else if (addr >= HRAM_BASE && addr <= HRAM_END) {
-        return hram[addr - HRAM_BASE];
+    else if (addr >= WRAM_BASE && last <= WRAM_END) {
+        return &wram[addr - WRAM_BASE];
     }
-    else if (addr >= IO_BASE && addr <= IO_END) {
-		uint8_t data;
-		switch (addr) {
-		case JOYP_ADDR:
-            data = m_joypad->read_byte();
-			break;
-		case IF_ADDR:
-			data = m_int_observer->read_byte(IF_ADDR);
-			break;
-        case DIV_ADDR:
-        case TIMA_ADDR:
-        case TMA_ADDR:
-        case TAC_ADDR:
-            data = m_timer->read_byte(addr);
-            break;
-        case LCDC_ADDR:
-        case STAT_ADDR:
-        case SCY_ADDR:
-        case SCX_ADDR:
-        case LY_ADDR:
-        case LYC_ADDR:
-        case BGP_ADDR:
-        case OBJ0_ADDR:
-        case OBJ1_ADDR:
-        case WY_ADDR:
-        case WX_ADDR:
-            data = m_ppu->read_byte(addr);
-            break;
-        case 0xFF4D:  // KEY1 - used to switch speed in CGB mode
-            // STUB to 0xFF
-            data = 0xFF;
-            break;
-		default:
-        	data = IO[addr - IO_BASE];
-			break;
-		}
-		return data;
+    else if (addr >= ECHO_BASE && last <= ECHO_END) {
+        return &wram[addr - ECHO_BASE];
     }
-    else if (addr >= OAM_BASE && addr <= OAM_END) {
-        return m_ppu->read_byte(addr);
+    else if (addr >= VRAM_BASE && last <= VRAM_END) {
+        return m_ppu->vram_ptr(addr, len);
     }
-    else if (addr == IE_ADDR) {
-        return m_int_observer->read_byte(IE_ADDR);
-    } else if (addr >= PROHIB_BASE && addr <= PROHIB_END) {
-        return 00;
-    } else {
-       //fmt::print("Illegal memory access: {:#04x}\n", addr);
-       exit(-1);
+    else if (addr >= HRAM_BASE && last <= HRAM_END) {
+        return &hram[addr - HRAM_BASE];
     }
-    return 0;
+    return nullptr;
 }
 
-void MemoryBus::write_byte(uint16_t addr, uint8_t value) {
-    if (addr >= ROM_BASE && addr <= ROM_END) {
-        cart->write_byte(addr, value);
-    }
-    else if (addr >= EXRAM_BASE && addr <= EXRAM_END) {
-        cart->write_byte(addr, value);
+uint8_t *MemoryBus::write_ptr(uint16_t addr, uint16_t len) {
+    uint32_t last = addr + len - 1;
+    if (addr >= VRAM_BASE && last <= VRAM_END) {
+        return m_ppu->vram_ptr(addr, len);
     }
-    else if (addr >= VRAM_BASE && addr <= VRAM_END) {
-        m_ppu->write_byte(addr, value);
+    else if (addr >= WRAM_BASE && last <= WRAM_END) {
+        return &wram[addr - WRAM_BASE];
     }
-    else if (addr >= WRAM_BASE && addr <= WRAM_END) {
-        wram[addr - WRAM_BASE] = value;
+    else if (addr >= ECHO_BASE && last <= ECHO_END) {
+        return &wram[addr - ECHO_BASE];
     }
-    else if (addr >= ECHO_BASE && addr <= ECHO_END) {
-        wram[addr - ECHO_BASE] = value;
+    else if (addr >= HRAM_BASE && last <= HRAM_END) {
+        return &hram[addr - HRAM_BASE];
     }
-    else if (addr >= HRAM_BASE && addr <= HRAM_END) {
-        hram[addr - HRAM_BASE] = value;
-    }
-    else if (addr >= IO_BASE && addr <= IO_END) {
-		switch(addr) {
-		case JOYP_ADDR:
-            m_joypad->write_byte(value);
-			break;
-		case IF_ADDR:
-            m_int_observer->write_byte(IF_ADDR, value);
-			break;
-        case DIV_ADDR:
-        case TIMA_ADDR:
-        case TMA_ADDR:
-        case TAC_ADDR:
-            m_timer->write_byte(addr, value);
-            break;
-        case LCDC_ADDR:
-        case STAT_ADDR:
-        case SCY_ADDR:
-        case SCX_ADDR:
-        case LY_ADDR:
-        case LYC_ADDR:
-        case BGP_ADDR:
-        case OBJ0_ADDR:
-        case OBJ1_ADDR:
-        case WY_ADDR:
-        case WX_ADDR:
-            m_ppu->write_byte(addr, value);
-            break;
-        case DMA_ADDR:
-        	//IO[addr - IO_BASE] = value;
-            m_ppu->write_byte(addr, value);
-            break;
-		default:
-        	IO[addr - IO_BASE] = value;
-			break;
-		}
-        if (addr == SB_ADDR) {
-            //fmt::print("{:c}", value);
-        }
-    }
-    else if (addr >= OAM_BASE && addr <= OAM_END) {
-        m_ppu->write_byte(addr, value);
-    } else if (addr == IE_ADDR) {
-        m_int_observer->write_byte(IE_ADDR, value);
-    } else {
-       //fmt::print("Illegal memory access: {:#04x}\n", addr);
-    }
-    return;
-}
-
-uint16_t MemoryBus::read_word(uint16_t addr) {
-    uint16_t lo, hi;
-    lo = read_byte(addr);
-    hi = read_byte(addr + 1);
-    return ((hi << 8) & 0xFF00) | (lo & 0xFF);
-}
-
-void MemoryBus::write_word(uint16_t addr, uint16_t value) {
-    // lo write
-    write_byte(addr, value & 0xFF);
-    // hi write
-    write_byte(addr + 1, (value >> 8) & 0xFF);
+    return nullptr;
 }
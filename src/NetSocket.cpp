@@ -0,0 +1,177 @@
+#include "NetSocket.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// resolved form of an address, either family
+struct SocketAddress {
+    sockaddr_storage storage{};
+    socklen_t len{0};
+    bool is_unix{false};
+};
+
+bool resolve(const std::string &address, bool passive, SocketAddress &out) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || address.find('/') != std::string::npos) {
+        sockaddr_un un{};
+        if (address.size() >= sizeof(un.sun_path)) {
+            return false;
+        }
+        un.sun_family = AF_UNIX;
+        std::memcpy(un.sun_path, address.c_str(), address.size() + 1);
+        std::memcpy(&out.storage, &un, sizeof(un));
+        out.len = sizeof(un);
+        out.is_unix = true;
+        return true;
+    }
+
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo *info = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0) {
+        return false;
+    }
+    std::memcpy(&out.storage, info->ai_addr, info->ai_addrlen);
+    out.len = info->ai_addrlen;
+    freeaddrinfo(info);
+    return true;
+}
+
+// one small packet per frame, don't let Nagle hold it back
+void set_no_delay(int fd, const SocketAddress &address) {
+    if (!address.is_unix) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+}
+
+}
+
+NetSocket::NetSocket(NetSocket &&other) noexcept
+    : m_fd{std::exchange(other.m_fd, -1)} {
+}
+
+NetSocket &NetSocket::operator=(NetSocket &&other) noexcept {
+    if (this != &other) {
+        close();
+        m_fd = std::exchange(other.m_fd, -1);
+    }
+    return *this;
+}
+
+NetSocket::~NetSocket() {
+    close();
+}
+
+bool NetSocket::listen(const std::string &address) {
+    close();
+    SocketAddress addr;
+    if (!resolve(address, true, addr)) {
+        return false;
+    }
+    int listener = ::socket(addr.storage.ss_family, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+    if (addr.is_unix) {
+        unlink(address.c_str());
+    } else {
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&addr.storage), addr.len) != 0
+        || ::listen(listener, 1) != 0) {
+        ::close(listener);
+        return false;
+    }
+    m_fd = ::accept(listener, nullptr, nullptr);
+    ::close(listener);
+    if (addr.is_unix) {
+        unlink(address.c_str());
+    }
+    if (m_fd >= 0) {
+        set_no_delay(m_fd, addr);
+    }
+    return m_fd >= 0;
+}
+
+bool NetSocket::connect(const std::string &address, int timeout_ms) {
+    close();
+    SocketAddress addr;
+    if (!resolve(address, false, addr)) {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        int fd = ::socket(addr.storage.ss_family, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&addr.storage), addr.len) == 0) {
+            m_fd = fd;
+            set_no_delay(m_fd, addr);
+            return true;
+        }
+        ::close(fd);
+        // the other side may not be listening yet
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+void NetSocket::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool NetSocket::send_all(const void *data, size_t len) {
+    const char *bytes = static_cast<const char *>(data);
+    while (len > 0) {
+        ssize_t sent = ::send(m_fd, bytes, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+long NetSocket::receive(void *data, size_t len, bool wait) {
+    while (true) {
+        ssize_t got = ::recv(m_fd, data, len, wait ? 0 : MSG_DONTWAIT);
+        if (got > 0) {
+            return got;
+        }
+        if (got == 0) {
+            return -1;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+}
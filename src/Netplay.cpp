@@ -0,0 +1,150 @@
+#include "Netplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+constexpr char NETPLAY_MAGIC[4] = {'M', 'B', 'N', 'P'};
+constexpr uint8_t NETPLAY_VERSION = 1;
+
+struct SettingsPacket {
+    char magic[4];
+    uint8_t version;
+    uint8_t idle_skip;
+    uint8_t reserved[2];
+};
+static_assert(sizeof(SettingsPacket) == 8);
+
+}
+
+bool netplay_handshake(NetSocket &socket, bool host, NetplaySettings &settings) {
+    SettingsPacket packet{};
+    std::memcpy(packet.magic, NETPLAY_MAGIC, sizeof(packet.magic));
+    packet.version = NETPLAY_VERSION;
+    packet.idle_skip = settings.idle_skip;
+    if (!socket.send_all(&packet, sizeof(packet))) {
+        return false;
+    }
+
+    SettingsPacket peer{};
+    size_t len = 0;
+    while (len < sizeof(peer)) {
+        long got = socket.receive(reinterpret_cast<uint8_t *>(&peer) + len, sizeof(peer) - len, true);
+        if (got < 0) {
+            return false;
+        }
+        len += got;
+    }
+    if (std::memcmp(peer.magic, NETPLAY_MAGIC, sizeof(peer.magic)) != 0 || peer.version != NETPLAY_VERSION) {
+        return false;
+    }
+    if (!host) {
+        settings.idle_skip = peer.idle_skip != 0;
+    }
+    return true;
+}
+
+Netplay::Netplay(System &left, System &right, int local_side, NetSocket socket)
+    : m_systems{&left, &right},
+      m_cable{left, right},
+      m_local{local_side},
+      m_remote{1 - local_side},
+      m_socket{std::move(socket)},
+      m_snapshots(ROLLBACK_FRAMES + 1) {
+}
+
+bool Netplay::run_frame(uint8_t local_buttons) {
+    int64_t wrong = receive(false);
+    // too far ahead to keep predicting, the peer has to catch up first
+    while (wrong >= 0 && m_frame >= m_confirmed + ROLLBACK_FRAMES) {
+        ++m_stats.stalls;
+        int64_t more = receive(true);
+        wrong = more < 0 ? more : std::min(wrong, more);
+    }
+    if (wrong < 0) {
+        return false;
+    }
+    if (wrong < m_frame) {
+        rollback(static_cast<uint32_t>(wrong));
+    }
+
+    InputPacket packet{m_frame, local_buttons, {}};
+    if (!m_socket.send_all(&packet, sizeof(packet))) {
+        return false;
+    }
+    FrameInput &input = m_inputs[m_frame % m_inputs.size()];
+    input.buttons[m_local] = local_buttons;
+    if (m_frame >= m_confirmed) {
+        input.buttons[m_remote] = m_remote_buttons;
+    }
+    simulate(m_frame);
+    ++m_frame;
+    return true;
+}
+
+int64_t Netplay::receive(bool wait) {
+    int64_t wrong = m_frame;
+    while (true) {
+        long got = m_socket.receive(m_packet + m_packet_len, sizeof(m_packet) - m_packet_len, wait);
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            return wrong;
+        }
+        m_packet_len += got;
+        if (m_packet_len < sizeof(m_packet)) {
+            continue;
+        }
+        m_packet_len = 0;
+        wait = false;
+
+        // packets come in order, one per frame
+        InputPacket packet;
+        std::memcpy(&packet, m_packet, sizeof(packet));
+        FrameInput &input = m_inputs[packet.frame % m_inputs.size()];
+        if (packet.frame < m_frame && input.buttons[m_remote] != packet.buttons) {
+            wrong = std::min<int64_t>(wrong, packet.frame);
+        }
+        input.buttons[m_remote] = packet.buttons;
+        m_remote_buttons = packet.buttons;
+        m_confirmed = packet.frame + 1;
+    }
+}
+
+void Netplay::simulate(uint32_t frame) {
+    Snapshot &snapshot = m_snapshots[frame % m_snapshots.size()];
+    snapshot.systems[0] = *m_systems[0];
+    snapshot.systems[1] = *m_systems[1];
+    snapshot.cable_cycles = m_cable.cycles();
+
+    const FrameInput &input = m_inputs[frame % m_inputs.size()];
+    m_systems[0]->joypad.set_buttons(input.buttons[0]);
+    m_systems[1]->joypad.set_buttons(input.buttons[1]);
+    m_cable.run_frame();
+}
+
+void Netplay::rollback(uint32_t frame) {
+    auto start = std::chrono::steady_clock::now();
+    const Snapshot &snapshot = m_snapshots[frame % m_snapshots.size()];
+    *m_systems[0] = snapshot.systems[0];
+    *m_systems[1] = snapshot.systems[1];
+    m_cable.set_cycles(snapshot.cable_cycles);
+
+    // frames the peer hasn't confirmed yet keep predicting its latest buttons
+    for (uint32_t f = frame; f < m_frame; ++f) {
+        if (f >= m_confirmed) {
+            m_inputs[f % m_inputs.size()].buttons[m_remote] = m_remote_buttons;
+        }
+        simulate(f);
+    }
+
+    ++m_stats.rollbacks;
+    m_stats.frames_resimulated += m_frame - frame;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (ms > m_stats.max_rollback_ms) {
+        m_stats.max_rollback_ms = ms;
+    }
+}
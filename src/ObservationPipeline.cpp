@@ -0,0 +1,157 @@
+#include "ObservationPipeline.h"
+#include "Ppu.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// luma out of 0xAARRGGBB, the BT.601 weights scaled to 256
+constexpr int R_WEIGHT = 77;
+constexpr int G_WEIGHT = 150;
+constexpr int B_WEIGHT = 29;
+
+uint16_t luma(uint32_t px) {
+    return (((px >> 16) & 0xFF) * R_WEIGHT + ((px >> 8) & 0xFF) * G_WEIGHT + (px & 0xFF) * B_WEIGHT) >> 8;
+}
+
+// adds the gray of len pixels to sums
+void add_gray_row(const uint32_t *pixels, int len, uint16_t *sums, const std::array<uint16_t, 4> &) {
+    int i = 0;
+#if defined(__SSE2__)
+    // the pixels split into 16 bit (B, R) and (G, A) pairs, madd then
+    // weighs and adds each pair in one go
+    const __m128i low_bytes = _mm_set1_epi32(0x00FF00FF);
+    const __m128i br_weights = _mm_set1_epi32(R_WEIGHT << 16 | B_WEIGHT);
+    const __m128i ga_weights = _mm_set1_epi32(G_WEIGHT);
+    auto gray4 = [&](__m128i px) {
+        __m128i br = _mm_and_si128(px, low_bytes);
+        __m128i ga = _mm_and_si128(_mm_srli_epi32(px, 8), low_bytes);
+        __m128i sum = _mm_add_epi32(_mm_madd_epi16(br, br_weights), _mm_madd_epi16(ga, ga_weights));
+        return _mm_srli_epi32(sum, 8);
+    };
+    for (; i + 8 <= len; i += 8) {
+        __m128i lo = gray4(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i)));
+        __m128i hi = gray4(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i + 4)));
+        // gray fits in 8 bits so the signed pack can't saturate
+        __m128i gray = _mm_packs_epi32(lo, hi);
+        __m128i *out = reinterpret_cast<__m128i *>(sums + i);
+        _mm_storeu_si128(out, _mm_add_epi16(_mm_loadu_si128(out), gray));
+    }
+#endif
+    for (; i < len; ++i) {
+        sums[i] += luma(pixels[i]);
+    }
+}
+
+void add_gray_row(const uint8_t *shades, int len, uint16_t *sums, const std::array<uint16_t, 4> &gray) {
+    int i = 0;
+#if defined(__SSE2__)
+    // no byte shuffle in SSE2, but with four shades the gray is the gray of
+    // shade 0 plus the difference to each other shade where it matches
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i base = _mm_set1_epi16(gray[0]);
+    __m128i shade[4];
+    __m128i step[4];
+    for (int s = 1; s < 4; ++s) {
+        shade[s] = _mm_set1_epi16(s);
+        step[s] = _mm_set1_epi16(gray[s] - gray[0]);
+    }
+    for (; i + 8 <= len; i += 8) {
+        __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(shades + i)), zero);
+        __m128i value = base;
+        for (int s = 1; s < 4; ++s) {
+            value = _mm_add_epi16(value, _mm_and_si128(_mm_cmpeq_epi16(px, shade[s]), step[s]));
+        }
+        __m128i *out = reinterpret_cast<__m128i *>(sums + i);
+        _mm_storeu_si128(out, _mm_add_epi16(_mm_loadu_si128(out), value));
+    }
+#endif
+    for (; i < len; ++i) {
+        sums[i] += gray[shades[i]];
+    }
+}
+
+}
+
+ObservationPipeline::ObservationPipeline(ObservationConfig config) : m_config{config} {
+    ObservationConfig &c = m_config;
+    c.crop_x = std::clamp(c.crop_x, 0, dmg::WIDTH - 1);
+    c.crop_y = std::clamp(c.crop_y, 0, dmg::HEIGHT - 1);
+    c.crop_width = std::clamp(c.crop_width, 1, dmg::WIDTH - c.crop_x);
+    c.crop_height = std::clamp(c.crop_height, 1, dmg::HEIGHT - c.crop_y);
+    // only ever scaled down, an output pixel covers at least one screen pixel
+    c.width = std::clamp(c.width, 1, c.crop_width);
+    c.height = std::clamp(c.height, 1, c.crop_height);
+    c.stack = std::max(c.stack, 1);
+
+    m_columns = make_spans(c.crop_width, c.width);
+    m_rows = make_spans(c.crop_height, c.height);
+    for (const Span &row : m_rows) {
+        for (const Span &column : m_columns) {
+            uint64_t covered = (row.last - row.first) * (column.last - column.first);
+            m_scale.push_back(((uint64_t{1} << 32) + covered / 2) / covered);
+        }
+    }
+    m_row_sums.resize(c.crop_width);
+    m_prefix.resize(c.crop_width + 1);
+    for (int s = 0; s < 4; ++s) {
+        m_shade_gray[s] = luma(gPalette[s]);
+    }
+    m_frames.resize(static_cast<size_t>(c.stack) * c.width * c.height);
+    clear();
+}
+
+std::vector<ObservationPipeline::Span> ObservationPipeline::make_spans(int from, int to) {
+    std::vector<Span> spans;
+    for (int i = 0; i < to; ++i) {
+        spans.push_back(Span{i * from / to, (i + 1) * from / to});
+    }
+    return spans;
+}
+
+void ObservationPipeline::clear() {
+    std::fill(m_frames.begin(), m_frames.end(), 0);
+    m_newest = m_config.stack - 1;
+}
+
+void ObservationPipeline::push(const uint32_t *frame) {
+    push_frame(frame);
+}
+
+void ObservationPipeline::push(const uint8_t *shades) {
+    push_frame(shades);
+}
+
+template <typename Pixel>
+void ObservationPipeline::push_frame(const Pixel *frame) {
+    const ObservationConfig &c = m_config;
+    m_newest = (m_newest + 1) % c.stack;
+    uint8_t *out = m_frames.data() + static_cast<size_t>(m_newest) * c.width * c.height;
+    const uint64_t *scale = m_scale.data();
+    for (const Span &row : m_rows) {
+        std::fill(m_row_sums.begin(), m_row_sums.end(), 0);
+        for (int y = row.first; y < row.last; ++y) {
+            add_gray_row(frame + (c.crop_y + y) * dmg::WIDTH + c.crop_x, c.crop_width, m_row_sums.data(), m_shade_gray);
+        }
+        for (int x = 0; x < c.crop_width; ++x) {
+            m_prefix[x + 1] = m_prefix[x] + m_row_sums[x];
+        }
+        for (const Span &column : m_columns) {
+            uint64_t sum = m_prefix[column.last] - m_prefix[column.first];
+            *out++ = static_cast<uint8_t>((sum * *scale++ + (uint64_t{1} << 31)) >> 32);
+        }
+    }
+}
+
+void ObservationPipeline::write(uint8_t *out) const {
+    size_t frame_size = static_cast<size_t>(m_config.width) * m_config.height;
+    // the ring starts after the newest frame
+    size_t oldest = (m_newest + 1) % m_config.stack * frame_size;
+    std::memcpy(out, m_frames.data() + oldest, m_frames.size() - oldest);
+    std::memcpy(out + m_frames.size() - oldest, m_frames.data(), oldest);
+}
@@ -19,22 +19,32 @@ Ppu::Ppu()
   m_sprites_visible{0},
   m_vram_blocked{false},
   m_oam_blocked{false},
+  m_dma_source{0},
+  m_dma_cycles{0},
+  m_dma_completed{false},
   m_dots{0},
   m_mode{LcdMode::HBLANK},
   m_lcd{},
   m_was_window_drawn{false},
-  m_current_sprite{nullptr},
-  m_sprite_rendering_started{false},
+  m_bg_line{},
+  m_sprite_line{},
   m_vram(0x2000, 0),
   m_oam(0xA0, 0),
-  m_oam_table{0},
-  m_bus{},
+  m_line_sprites{},
+  m_line_sprite_count{},
+  m_sprite_lines_dirty{true},
+  m_sprite_lines_tall{false},
+  m_bus{nullptr},
   m_frame_buffer(dmg::WIDTH * dmg::HEIGHT, 0),
+  m_shade_buffer(dmg::WIDTH * dmg::HEIGHT, 0),
   m_int_observer{nullptr} {}
 
 bool Ppu::step(int cycles) {
     // cycles are in T cycles,
     m_frame_ready = false;
+    if (m_dma_cycles > 0) {
+        step_dma(cycles);
+    }
     while (cycles > 0) {
         switch(m_mode) {
             case LcdMode::HBLANK:
@@ -54,9 +64,92 @@ bool Ppu::step(int cycles) {
     return m_frame_ready;
 }
 
+int Ppu::cycles_until_interrupt() {
+    // walk the mode changes ahead of us without rendering anything until one
+    // of them requests an interrupt, vblank always does so this ends within a frame
+    LcdMode mode = m_mode;
+    int ly = m_lcd.LY;
+    int dots = m_dots;
+    int cycles = 0;
+    while (true) {
+        switch (mode) {
+        case LcdMode::OAM_SEARCH:
+            cycles += OAM_CYCLES - dots;
+            mode = LcdMode::DATA_TRANSFER;
+            break;
+        case LcdMode::DATA_TRANSFER:
+            cycles += PIXEL_TRANSFER_CYCLES - dots;
+            mode = LcdMode::HBLANK;
+            if (m_lcd.stat_get_hblank_int_enabled()) {
+                return cycles;
+            }
+            break;
+        case LcdMode::HBLANK:
+            cycles += SCAN_LINE_CYCLES - (PIXEL_TRANSFER_CYCLES + OAM_CYCLES + dots);
+            ++ly;
+            if (ly == m_lcd.LYC && m_lcd.stat_get_lyc_int_enabled()) {
+                return cycles;
+            }
+            if (ly >= dmg::HEIGHT) {
+                return cycles;
+            }
+            mode = LcdMode::OAM_SEARCH;
+            if (m_lcd.stat_get_oam_int_enabled()) {
+                return cycles;
+            }
+            break;
+        case LcdMode::VBLANK:
+            cycles += SCAN_LINE_CYCLES - dots;
+            if (++ly > dmg::HEIGHT + VBLANK_LINES) {
+                ly = 0;
+                mode = LcdMode::OAM_SEARCH;
+                if (m_lcd.stat_get_oam_int_enabled()) {
+                    return cycles;
+                }
+            }
+            break;
+        }
+        dots = 0;
+    }
+}
+
+int Ppu::cycles_until_ly_change() {
+    int dots = m_dots;
+    switch (m_mode) {
+    case LcdMode::OAM_SEARCH:
+        return OAM_CYCLES - dots + PIXEL_TRANSFER_CYCLES + HBLANK_CYCLES;
+    case LcdMode::DATA_TRANSFER:
+        return PIXEL_TRANSFER_CYCLES - dots + HBLANK_CYCLES;
+    case LcdMode::HBLANK:
+        return HBLANK_CYCLES - dots;
+    case LcdMode::VBLANK:
+        return SCAN_LINE_CYCLES - dots;
+    }
+    return 0;
+}
+
+int Ppu::cycles_until_mode_change() {
+    int dots = m_dots;
+    switch (m_mode) {
+    case LcdMode::OAM_SEARCH:
+        return OAM_CYCLES - dots;
+    case LcdMode::DATA_TRANSFER:
+        return PIXEL_TRANSFER_CYCLES - dots;
+    case LcdMode::HBLANK:
+        return HBLANK_CYCLES - dots;
+    case LcdMode::VBLANK:
+        // the LYC coincidence flag can still change every line
+        return SCAN_LINE_CYCLES - dots;
+    }
+    return 0;
+}
+
 void Ppu::reset() {
     m_vram_blocked = false;
     m_oam_blocked = false;
+    m_dma_source = 0;
+    m_dma_cycles = 0;
+    m_dma_completed = false;
     m_dots = 0;
     m_mode = LcdMode::HBLANK;
     m_lcd.LCDC = 0x91;
@@ -72,86 +165,105 @@ void Ppu::reset() {
     m_lcd.WX = 0x00;
     std::fill(m_vram.begin(), m_vram.end(), 0);
     std::fill(m_oam.begin(), m_oam.end(), 0);
-    // std::fill(m_oam_table.begin(), m_oam_table.end(), 0);
-    m_oam_table.clear();
+    m_sprite_lines_dirty = true;
     std::fill(m_frame_buffer.begin(), m_frame_buffer.end(), gPalette[0]);
+    std::fill(m_shade_buffer.begin(), m_shade_buffer.end(), 0);
+    m_colors_stale = false;
+}
+
+uint32_t *Ppu::get_frame_buffer() {
+    if (m_colors_stale) {
+        for (size_t i = 0; i < m_shade_buffer.size(); ++i) {
+            m_frame_buffer[i] = gPalette[m_shade_buffer[i]];
+        }
+        m_colors_stale = false;
+    }
+    return m_frame_buffer.data();
+}
+
+void Ppu::set_indexed(bool enabled) {
+    // leaving indexed mode, catch the colors up before drawing them directly
+    get_frame_buffer();
+    m_indexed = enabled;
+}
+
+void Ppu::register_io_handlers(MemoryBus &bus) {
+    // most registers are plain bytes the cpu reads and writes directly
+    for (auto [addr, reg] : {std::pair{LCDC_ADDR, &m_lcd.LCDC}, {SCY_ADDR, &m_lcd.SCY}, {SCX_ADDR, &m_lcd.SCX},
+                             {LYC_ADDR, &m_lcd.LYC}, {BGP_ADDR, &m_lcd.BGP}, {OBJ0_ADDR, &m_lcd.OBP0},
+                             {OBJ1_ADDR, &m_lcd.OBP1}, {WY_ADDR, &m_lcd.WY}, {WX_ADDR, &m_lcd.WX}}) {
+        bus.register_io_handler(addr, io_plain_register(reg));
+    }
+    bus.register_io_handler(LY_ADDR, IoHandler{io_read_byte, io_write_ignore, &m_lcd.LY});
+    // the mode bits of STAT are read only
+    bus.register_io_handler(STAT_ADDR, IoHandler{
+        io_read_byte,
+        [](void *ctx, uint16_t, uint8_t value) {
+            uint8_t &stat = *static_cast<uint8_t *>(ctx);
+            stat = (value & 0xFC) | (stat & 0x03);
+        },
+        &m_lcd.STAT});
+    bus.register_io_handler(DMA_ADDR, IoHandler{
+        [](void *ctx, uint16_t) { return static_cast<Ppu *>(ctx)->m_dma_source; },
+        [](void *ctx, uint16_t, uint8_t value) { static_cast<Ppu *>(ctx)->request_dma_transfer(value); },
+        this});
 }
 
 uint8_t Ppu::read_byte(uint16_t addr) {
-    if (addr == LCDC_ADDR) {
-        return m_lcd.LCDC;
-    } else if (addr == STAT_ADDR) {
-        return m_lcd.STAT;
-    } else if (addr == SCY_ADDR) {
-        return m_lcd.SCY;
-    } else if (addr == SCX_ADDR) {
-        return m_lcd.SCX;
-    } else if (addr == LY_ADDR) {
-        return m_lcd.LY;
-    } else if (addr == LYC_ADDR) {
-        return m_lcd.LYC;
-    } else if (addr == BGP_ADDR) {
-        return m_lcd.BGP;
-    } else if (addr == OBJ0_ADDR) {
-        return m_lcd.OBP0;
-    } else if (addr == OBJ1_ADDR) {
-        return m_lcd.OBP1;
-    } else if (addr == WY_ADDR) {
-        return m_lcd.WY;
-    } else if (addr == WX_ADDR) {
-        return m_lcd.WX;
-    } else if (addr >= VRAM_BASE && addr <= VRAM_END) {
+    if (addr >= VRAM_BASE && addr <= VRAM_END) {
         if (m_vram_blocked) return 0xFF;
         return m_vram[addr - VRAM_BASE];
     } else if (addr >= OAM_BASE && addr <= OAM_END) {
-        if (m_oam_blocked) return 0xFF;
+        if (m_oam_blocked || dma_active()) return 0xFF;
         return m_oam[addr - OAM_BASE];
     }
     return 0;
 }
 
 void Ppu::write_byte(uint16_t addr, uint8_t value) {
-    if (addr == LCDC_ADDR) {
-        m_lcd.LCDC = value;
-    } else if (addr == STAT_ADDR) {
-        uint8_t old_stat = m_lcd.STAT;
-        m_lcd.STAT = value & 0xFC;
-        m_lcd.STAT |= old_stat & 0x03;
-    } else if (addr == SCY_ADDR) {
-        m_lcd.SCY = value;
-    } else if (addr == SCX_ADDR) {
-        m_lcd.SCX = value;
-    } else if (addr == LY_ADDR) {
-        return;
-    } else if (addr == LYC_ADDR) {
-        m_lcd.LYC = value;
-    } else if (addr == DMA_ADDR) {
-        request_dma_transfer(value);
-    } else if (addr == BGP_ADDR) {
-        m_lcd.BGP = value;
-    } else if (addr == OBJ0_ADDR) {
-        m_lcd.OBP0 = value;
-    } else if (addr == OBJ1_ADDR) {
-        m_lcd.OBP1 = value;
-    } else if (addr == WY_ADDR) {
-        m_lcd.WY = value;
-    } else if (addr == WX_ADDR) {
-        m_lcd.WX = value;
-    } else if (addr >= VRAM_BASE && addr <= VRAM_END) {
+    if (addr >= VRAM_BASE && addr <= VRAM_END) {
         if (m_vram_blocked) return;
         m_vram[addr - VRAM_BASE] = value;
     } else if (addr >= OAM_BASE && addr <= OAM_END) {
-        if (m_oam_blocked) return;
+        if (m_oam_blocked || dma_active()) return;
         m_oam[addr - OAM_BASE] = value;
+        m_sprite_lines_dirty = true;
     }
 }
 
+uint8_t *Ppu::vram_ptr(uint16_t addr, uint16_t len) {
+    if (m_vram_blocked || addr < VRAM_BASE || addr + len > VRAM_END + 1) {
+        return nullptr;
+    }
+    return &m_vram[addr - VRAM_BASE];
+}
+
 void Ppu::request_dma_transfer(uint8_t addr) {
+    m_dma_source = addr;
     uint16_t source_addr = addr * 0x100;
-    auto p = m_bus.lock();
-    for (size_t i = 0; i < m_oam.size(); ++i) {
-        // maybe a std::copy
-        m_oam[i] = p->read_byte(source_addr + i);
+    // the source page is snapshotted up front, the cpu can't see OAM until
+    // the transfer would have finished anyway
+    if (source_addr >= VRAM_BASE && source_addr + m_oam.size() - 1 <= VRAM_END) {
+        auto src = m_vram.begin() + (source_addr - VRAM_BASE);
+        std::copy(src, src + m_oam.size(), m_oam.begin());
+    } else if (const uint8_t *src = m_bus->read_ptr(source_addr, m_oam.size())) {
+        std::copy(src, src + m_oam.size(), m_oam.begin());
+    } else {
+        for (size_t i = 0; i < m_oam.size(); ++i) {
+            m_oam[i] = m_bus->read_byte(source_addr + i);
+        }
+    }
+    m_sprite_lines_dirty = true;
+    // writing DMA while a transfer is running restarts it
+    m_dma_cycles = DMA_CYCLES;
+    m_dma_completed = false;
+}
+
+void Ppu::step_dma(int cycles) {
+    m_dma_cycles -= cycles;
+    if (m_dma_cycles <= 0) {
+        m_dma_cycles = 0;
+        m_dma_completed = true;
     }
 }
 
@@ -172,13 +284,10 @@ void Ppu::ppu_switch_mode(LcdMode next) {
         break;
     case LcdMode::DATA_TRANSFER:
         m_mode = LcdMode::DATA_TRANSFER;
-        m_current_sprite = nullptr;
-        m_sprite_rendering_started = false;
         break;
     case LcdMode::OAM_SEARCH:
         //m_oam_blocked = true;
         m_mode = LcdMode::OAM_SEARCH;
-        m_oam_table.clear();
         // TODO - check when the interrupt is fired
         stat_int = m_lcd.stat_get_oam_int_enabled();
         break;
@@ -232,45 +341,44 @@ int Ppu::ppu_mode_vblank(int cycles) {
     return cycles;
 }
 
-void Ppu::search_oam() {
-    // DO OAM search here
-    uint8_t pos_x;
-    int real_pos_y;
-    int real_pos_x;
-    uint8_t obj_size;
-    m_sprites_visible = 0;
-    for(size_t i = 0; i < m_oam.size(); i += 4) {
-        // if we already have 10 sprites skip
-        if (m_sprites_visible == 10) { 
-            break; 
-        }
-        pos_x = m_oam[i+1];
-        real_pos_y = m_oam[i] - 16;
-        real_pos_x = m_oam[i+1] - 8;
-        obj_size = is_bit_set(m_lcd.lcdc_obj_size(), 2) ? 16 : 8;
-
-        // if our current LY is within the object we want to display it
-        if (is_between(m_lcd.LY, real_pos_y, real_pos_y + obj_size)) {
-            // we will skip on the objects that are hidden in the x axis
-            if (pos_x == 0 || pos_x >= 168) {
+void Ppu::build_sprite_lines() {
+    int obj_size = m_lcd.lcdc_obj_size() ? 16 : 8;
+    m_line_sprite_count.fill(0);
+
+    for (int i = 0; i < OAM_SPRITE_COUNT; ++i) {
+        OamAttribute sprite{m_oam[i * 4], m_oam[i * 4 + 1], m_oam[i * 4 + 2], m_oam[i * 4 + 3]};
+        int top = sprite.y_pos - 16;
+        int first_line = std::max(top, 0);
+        int last_line = std::min(top + obj_size, dmg::HEIGHT);
+
+        for (int line = first_line; line < last_line; ++line) {
+            // only the first 10 objects in OAM order are picked for a line,
+            // hidden ones (x == 0 or x >= 168) still take up a slot
+            uint8_t &count = m_line_sprite_count[line];
+            if (count == MAX_SPRITES_PER_LINE) {
                 continue;
             }
-
-            // save other attributes related to drawing 
-            m_oam_table.emplace_back(real_pos_y, real_pos_x, m_oam[i+2], m_oam[i+3]);
-            ++m_sprites_visible;
+            // insertion keeps the line sorted by x, ties stay in OAM order
+            auto &sprites = m_line_sprites[line];
+            int pos = count;
+            while (pos > 0 && sprites[pos - 1].x_pos > sprite.x_pos) {
+                sprites[pos] = sprites[pos - 1];
+                --pos;
+            }
+            sprites[pos] = sprite;
+            ++count;
         }
     }
+    m_sprite_lines_tall = m_lcd.lcdc_obj_size();
+    m_sprite_lines_dirty = false;
+}
 
-    // if table is empty we don't do anything else
-    if (m_oam_table.empty()) {
-        return;
+void Ppu::search_oam() {
+    // the per line tables only go stale when OAM or the object size changes
+    if (m_sprite_lines_dirty || m_sprite_lines_tall != m_lcd.lcdc_obj_size()) {
+        build_sprite_lines();
     }
-
-    // sort the table to be from smallest to biggest
-    std::sort(m_oam_table.begin(), m_oam_table.end(), [] (const OamAttribute &a, const OamAttribute &b) {
-        return a.x_pos < b.x_pos;
-    });
+    m_sprites_visible = m_line_sprite_count[m_lcd.LY];
 }
 
 int Ppu::ppu_mode_oam_search(int cycles) {
@@ -280,7 +388,6 @@ int Ppu::ppu_mode_oam_search(int cycles) {
         // consume the cycles remaining and return the rest for other modes to run
         cycles -= remaining_cycles;
         m_dots = 0;
-        m_oam_table.clear();
         search_oam();
         ppu_switch_mode(LcdMode::DATA_TRANSFER);
     } else {
@@ -297,12 +404,18 @@ int Ppu::ppu_mode_data_xfer(int cycles) {
         // consume the remaining cycles
         cycles -= remaining_cycles;
         m_dots = 0;
-        while(LX <= dmg::WIDTH) {
-            // this function will change modes for us
-            render_background();
-            render_window();
+        if (m_rendering) {
+            while(LX < dmg::WIDTH) {
+                // this function will change modes for us
+                render_background();
+                render_window();
+                ++LX;
+            }
             render_sprites();
-            ++LX;
+            m_colors_stale = m_indexed;
+        } else if (m_lcd.lcdc_window_enable() && m_lcd.LY >= m_lcd.WY && m_lcd.WX < dmg::WIDTH + 7) {
+            // the window's line counter moves whether it is drawn or not
+            m_was_window_drawn = true;
         }
         if (m_was_window_drawn) {
             ++WLY;
@@ -322,12 +435,13 @@ int Ppu::ppu_mode_data_xfer(int cycles) {
 // This is rendering the background
 void Ppu::render_background() {
     // m_vram_blocked = false;
-    // if background enable bit is not set we don't render
+    // if background enable bit is not set the background is blank
     if (m_lcd.lcdc_bg_enable_pri() == 0) {
+        m_bg_line[LX] = 0;
+        put_pixel(LX, 0);
         return;
     }
 
-    auto bus = m_bus.lock();
     uint16_t tilemap = m_lcd.lcdc_bg_tilemap() ? TILEMAP_1 : TILEMAP_2;
     uint16_t tiledata = m_lcd.lcdc_bg_tile_data() ? TILE_DATA_BASE_1 : TILE_DATA_BASE_2;
 
@@ -340,11 +454,11 @@ void Ppu::render_background() {
 
     uint16_t tile_addr = 0;
     if (tiledata == 0x8000) {
-        uint8_t tile_index = bus->read_byte(tilemap_addr);
+        uint8_t tile_index = m_vram[tilemap_addr - VRAM_BASE];
         tile_addr = tiledata + (tile_index * 16);
     } else {
         // 0x8800 addressing uses 0x9000 as a base with range -128 to 127
-        int8_t tile_index = bus->read_byte(tilemap_addr);
+        int8_t tile_index = m_vram[tilemap_addr - VRAM_BASE];
         tile_addr = tiledata + (tile_index * 16);
     }
 
@@ -352,8 +466,8 @@ void Ppu::render_background() {
     // ie: tile_addr + (pixel_y (0-7) * 2) (0 - 14) will choose which byte out of the 16 bytes 
     // since we are reading 8 bit we get low data then high data
     uint8_t pixel_y = (m_lcd.LY + m_lcd.SCY) % 8;
-    uint8_t tile_row_data_high = bus->read_byte(tile_addr + (pixel_y * 2));
-    uint8_t tile_row_data_low = bus->read_byte(tile_addr + (pixel_y * 2) + 1);
+    uint8_t tile_row_data_high = m_vram[tile_addr - VRAM_BASE + (pixel_y * 2)];
+    uint8_t tile_row_data_low = m_vram[tile_addr - VRAM_BASE + (pixel_y * 2) + 1];
 
     // we choose the x pixel within (0-7)
     uint8_t pixel_x = (LX + m_lcd.SCX) % 8;
@@ -362,12 +476,10 @@ void Ppu::render_background() {
     // since we draw from left to right we get the leftmost bits from the tile_row_data
     uint8_t color_val = (((tile_row_data_high >> (7 - pixel_x)) << 1) | (tile_row_data_low >> (7 - pixel_x))) & 0x03;
 
-    // grab a color from the palette
-    // BGP holds the value we need 00-11 for which color to use
-    uint32_t color = gPalette[(m_lcd.BGP >> (2 * color_val)) & 3];
-
+    // BGP holds the value we need 00-11 for which shade to use
     // output the pixel to the buffer
-    m_frame_buffer[m_lcd.LY * dmg::WIDTH + LX] = color;
+    m_bg_line[LX] = color_val;
+    put_pixel(LX, (m_lcd.BGP >> (2 * color_val)) & 3);
 }
 
 void Ppu::render_window() {
@@ -390,7 +502,6 @@ void Ppu::render_window() {
     m_was_window_drawn = true;
 
     uint16_t WLX = LX + 7 - m_lcd.WX; 
-    auto bus = m_bus.lock();
 
     uint16_t tilemap = m_lcd.lcdc_window_tilemap() ? TILEMAP_1 : TILEMAP_2;
     uint16_t tiledata = m_lcd.lcdc_bg_tile_data() ? TILE_DATA_BASE_1 : TILE_DATA_BASE_2;
@@ -406,25 +517,24 @@ void Ppu::render_window() {
 
     uint16_t tile_addr = 0;
     if (tiledata == 0x8000) {
-        uint8_t tile_index = bus->read_byte(tilemap_addr);
+        uint8_t tile_index = m_vram[tilemap_addr - VRAM_BASE];
         tile_addr = tiledata + (tile_index * 16);
     } else {
-        int8_t tile_index = bus->read_byte(tilemap_addr);
+        int8_t tile_index = m_vram[tilemap_addr - VRAM_BASE];
         // tilesize = 16
         tile_addr = tiledata + (tile_index * 16);
     }
 
     // get the tile data bytes
-    uint8_t tile_row_data_high = bus->read_byte(tile_addr + (pixel_y * 2));
-    uint8_t tile_row_data_low = bus->read_byte(tile_addr + (pixel_y * 2) + 1);
+    uint8_t tile_row_data_high = m_vram[tile_addr - VRAM_BASE + (pixel_y * 2)];
+    uint8_t tile_row_data_low = m_vram[tile_addr - VRAM_BASE + (pixel_y * 2) + 1];
 
     // The data is 
     uint8_t color_val = (((tile_row_data_high >> (7 - pixel_x)) << 1)| (tile_row_data_low >> (7 - pixel_x))) & 0x03;
 
-    // grab a color from the palette
-    uint32_t color = gPalette[(m_lcd.BGP >> (2 * color_val)) & 3];
-    // output the pixel to the buffer
-    m_frame_buffer[m_lcd.LY * dmg::WIDTH + LX] = color;
+    // grab a shade from the palette and output the pixel to the buffer
+    m_bg_line[LX] = color_val;
+    put_pixel(LX, (m_lcd.BGP >> (2 * color_val)) & 3);
 }
 
 void Ppu::render_sprites() {
@@ -433,93 +543,68 @@ void Ppu::render_sprites() {
         return;
     }
     // if there are no sprites skip
-    if (m_oam_table.empty()) {
+    if (m_sprites_visible == 0) {
         return;
     }
 
-    bool needs_change = false;
-    if (m_sprite_rendering_started) {
-        if (m_current_sprite == nullptr) {
-            return;
+    // rasterize the line's sprites into the line buffer first
+    m_sprite_line.fill({});
+    const auto &sprites = m_line_sprites[m_lcd.LY];
+    uint8_t obj_size = m_lcd.lcdc_obj_size() ? 16 : 8;
+    for (int i = 0; i < m_sprites_visible; ++i) {
+        const OamAttribute &sprite = sprites[i];
+        int x_pos = sprite.x_pos - 8;
+        if (x_pos <= -8 || x_pos >= dmg::WIDTH) {
+            continue;
         }
-        // we have started but we don't have a null ptr
-        // check if we are still within the lx range
-        if (!is_between(LX, m_current_sprite->x_pos, m_current_sprite->x_pos + 8)) {
-            needs_change = true;
-        }
-    } else {
-        // have not started and likely have a null ptr
-        needs_change = true;
-    }
 
-    if (needs_change) {
-        const auto sprite = std::find_if(m_oam_table.begin(), m_oam_table.end(), [*this](const OamAttribute &sprite) { 
-            return is_between(LX, sprite.x_pos, sprite.x_pos + 8); 
-        });
-
-        if (sprite == m_oam_table.end()) {
-            // m_current_sprite = nullptr;
-            return;
-        }
-        m_current_sprite = &(*sprite);
-        m_sprite_rendering_started = true;
-    } // keep the same object on else
-
-    // check the priority and skip if we can't draw
-    if (is_bit_set(m_current_sprite->attributes, SPRITE_BG_PRI)) {
-        // check the current color in the fb
-        uint32_t bg_color = m_frame_buffer[(m_lcd.LY * dmg::WIDTH) + LX];
-        // check whether the color corresponds to the bg 
-        // if bit 0 does not == bg color we can skip writing the sprite
-        if (gPalette[m_lcd.BGP & 0x3] != bg_color) {
-            return;
+        // we check if y flip flag
+        uint8_t tile_row = m_lcd.LY - (sprite.y_pos - 16);
+        if (is_bit_set(sprite.attributes, SPRITE_Y_FLIP)) {
+            tile_row = obj_size - 1 - tile_row;
         }
-    }
 
-    auto bus = m_bus.lock();
-    uint16_t tiledata = TILE_DATA_BASE_1;
-    uint16_t tile_addr = 0;
-    uint8_t tile_row = 0;
-
-    uint8_t tile_row_data_high;
-    uint8_t tile_row_data_low;
-    uint8_t color_val;
-    uint8_t palette;
-    uint32_t color;
-
-    // we check if y flip flag
-    if (is_bit_set(m_current_sprite->attributes, SPRITE_Y_FLIP)) {
-        // if 1 we y flip it 
-        tile_row = (m_lcd.lcdc_obj_size() ? 15 : 7) - (m_lcd.LY - m_current_sprite->y_pos);
-    } else {
-        tile_row = m_lcd.LY - m_current_sprite->y_pos;
-    }
+        // 8x16 objects ignore bit 0 of the tile index
+        uint8_t tile_index = sprite.tile_index;
+        if (m_lcd.lcdc_obj_size()) {
+            tile_index &= 0xFE;
+        }
+        uint16_t tile_addr = (TILE_DATA_BASE_1 - VRAM_BASE) + (tile_index * 16) + tile_row * 2;
+
+        // get the tile data bytes
+        uint8_t tile_row_data_high = m_vram[tile_addr];
+        uint8_t tile_row_data_low = m_vram[tile_addr + 1];
+        uint8_t palette = is_bit_set(sprite.attributes, SPRITE_BGP) ? m_lcd.OBP1 : m_lcd.OBP0;
+        bool bg_priority = is_bit_set(sprite.attributes, SPRITE_BG_PRI);
+        bool x_flip = is_bit_set(sprite.attributes, SPRITE_X_FLIP);
+
+        for (int pixel = 0; pixel < 8; ++pixel) {
+            int x = x_pos + pixel;
+            // sprites are sorted by x then OAM index, so the first one to
+            // claim a pixel has priority over the rest
+            if (x < 0 || x >= dmg::WIDTH || m_sprite_line[x].color_val) {
+                continue;
+            }
+            uint8_t offset = x_flip ? pixel : 7 - pixel;
+            uint8_t color_val = (((tile_row_data_high >> offset) << 1) | (tile_row_data_low >> offset)) & 0x03;
 
-    // check the height flag and modify the tile_index accordingly
-    if (m_lcd.lcdc_obj_size()) {
-        m_current_sprite->tile_index &= 0xFE;
+            // color 0 is transparent for sprites
+            if (color_val) {
+                m_sprite_line[x] = {color_val, palette, bg_priority};
+            }
+        }
     }
-    tile_addr = tiledata + (m_current_sprite->tile_index * 16) + tile_row * 2;
-
 
-    // get the tile data bytes
-    tile_row_data_low = bus->read_byte(tile_addr + 1);
-    tile_row_data_high = bus->read_byte(tile_addr);
-
-    // TODO - find out why we needthe 1
-    uint8_t sprite_offset = LX - m_current_sprite->x_pos - 1;
-    // drawing location offset - this is accounting for the the x-flip
-    uint8_t offset = is_bit_set(m_current_sprite->attributes, SPRITE_X_FLIP) ? sprite_offset : 7 - (sprite_offset);
-    color_val = (((tile_row_data_high >> (offset)) << 1)| (tile_row_data_low >> (offset))) & 0x03;
-
-    // sprites don't have transparent color so skip if color is 0
-    if (!color_val) {
-        return;
+    // composite the sprites over the background
+    for (int x = 0; x < dmg::WIDTH; ++x) {
+        const SpritePixel &pixel = m_sprite_line[x];
+        if (pixel.color_val == 0) {
+            continue;
+        }
+        // BG and window colors 1-3 are drawn over the sprite
+        if (pixel.bg_priority && m_bg_line[x] != 0) {
+            continue;
+        }
+        put_pixel(x, (pixel.palette >> (2 * pixel.color_val)) & 3);
     }
-
-    // grab a color from the palette
-    palette = is_bit_set(m_current_sprite->attributes, SPRITE_BGP) ?  m_lcd.OBP1 : m_lcd.OBP0;
-    color = gPalette[(palette >> (2 * color_val)) & 3];
-
-    m_frame_buffer[(m_lcd.LY * dmg::WIDTH) + LX] = color;
-}
\ No newline at end of file
+}
@@ -0,0 +1,36 @@
+#include "ResetPool.h"
+
+namespace {
+
+// snapshots don't hold on to anything outside the system
+void detach(System &system) {
+    system.cpu.attach_trace(nullptr);
+    system.serial.connect_sink(nullptr);
+    system.joypad.connect_host_input(nullptr);
+}
+
+}
+
+ResetPool::ResetPool(RomImage rom) {
+    System &start = m_snapshots.emplace_back();
+    start.reset();
+    start.load_cart(make_cartridge(std::move(rom)));
+}
+
+ResetPool::ResetPool(const System &start) {
+    save(start);
+}
+
+int ResetPool::save(const System &system) {
+    detach(m_snapshots.emplace_back(system));
+    return size() - 1;
+}
+
+void ResetPool::save(int slot, const System &system) {
+    m_snapshots.at(slot) = system;
+    detach(m_snapshots[slot]);
+}
+
+void ResetPool::restore(System &system, int slot) const {
+    system.restore(m_snapshots.at(slot));
+}
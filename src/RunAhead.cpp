@@ -0,0 +1,37 @@
+#include "RunAhead.h"
+
+RunAhead::RunAhead(System &system, int frames)
+    : m_system{system}, m_frames{0} {
+    set_frames(frames);
+}
+
+void RunAhead::set_frames(int frames) {
+    m_frames = frames > 0 ? frames : 0;
+    // a frame runs a little longer than run_frame's cycle budget, so a
+    // finished frame can start in the call before the one that finished it.
+    // The last two calls draw, the system's own is one of them when running 1 ahead
+    m_system.ppu.set_rendering(m_frames <= 1);
+}
+
+bool RunAhead::run_frame() {
+    bool frame_done = m_system.run_frame();
+    if (m_frames == 0) {
+        return frame_done;
+    }
+
+    // the copy starts where the system is now and keeps its buttons
+    m_ahead = m_system;
+    m_ahead.cpu.attach_trace(nullptr);
+    m_ahead.serial.connect_sink(nullptr);
+    m_ahead.joypad.connect_host_input(nullptr);
+    for (int i = 0; i < m_frames; ++i) {
+        m_ahead.ppu.set_rendering(i >= m_frames - 2);
+        frame_done = m_ahead.run_frame();
+    }
+    // the copy's frame is the one shown
+    return frame_done;
+}
+
+uint32_t *RunAhead::get_frame_buffer() {
+    return m_frames == 0 ? m_system.ppu.get_frame_buffer() : m_ahead.ppu.get_frame_buffer();
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <limits>
+
+#include "InterruptObserver.h"
+#include "MemoryBus.h"
+#include "Serial.h"
+
+void Serial::reset() {
+    m_sb = 0x00;
+    m_sc = 0x7E;
+    m_cycles_left = 0;
+    // a link cable sets it again before every slice it runs
+    m_external_horizon = std::numeric_limits<int>::max();
+}
+
+void Serial::register_io_handlers(MemoryBus &bus) {
+    auto read = [](void *ctx, uint16_t addr) { return static_cast<Serial *>(ctx)->read_byte(addr); };
+    auto write = [](void *ctx, uint16_t addr, uint8_t val) { static_cast<Serial *>(ctx)->write_byte(addr, val); };
+    for (uint16_t addr : {SB_ADDR, SC_ADDR}) {
+        bus.register_io_handler(addr, IoHandler{read, write, this});
+    }
+}
+
+uint8_t Serial::read_byte(uint16_t addr) {
+    switch(addr) {
+        case SB_ADDR: return m_sb;
+        case SC_ADDR: return m_sc | 0x7E;
+    }
+    return 0xFF;
+}
+
+void Serial::write_byte(uint16_t addr, uint8_t val) {
+    switch(addr) {
+        case SB_ADDR:
+            m_sb = val;
+            break;
+        case SC_ADDR:
+            m_sc = val & 0x81;
+            // (re)starting a transfer starts the byte over
+            m_cycles_left = internal_transfer() ? SERIAL_CYCLES_PER_BYTE : 0;
+            break;
+    }
+}
+
+uint8_t Serial::clock_in(uint8_t in) {
+    uint8_t out = m_sb;
+    m_sb = in;
+    m_sc &= 0x01;
+    m_int_obs->schedule_interrupt(InterruptSource::SERIAL);
+    return out;
+}
+
+int Serial::cycles_until_interrupt() const {
+    if (waiting_for_clock()) {
+        return m_external_horizon;
+    }
+    if (!internal_transfer()) {
+        return std::numeric_limits<int>::max();
+    }
+    return m_cycles_left;
+}
+
+void Serial::step(int cycles) {
+    if (m_external_horizon != std::numeric_limits<int>::max()) {
+        m_external_horizon = std::max(0, m_external_horizon - cycles);
+    }
+    if (!internal_transfer()) {
+        return;
+    }
+    m_cycles_left -= cycles;
+    if (m_cycles_left > 0) {
+        return;
+    }
+    m_sb = m_sink ? m_sink->transfer(m_sb) : 0xFF;
+    m_sc &= 0x01;
+    m_cycles_left = 0;
+    m_int_obs->schedule_interrupt(InterruptSource::SERIAL);
+}
@@ -0,0 +1,110 @@
+#include "System.h"
+
+#include <algorithm>
+#include <limits>
+
+System::System() {
+    connect();
+}
+
+System::System(const System &other)
+    : cpu{other.cpu},
+      int_obs{other.int_obs},
+      joypad{other.joypad},
+      timer{other.timer},
+      serial{other.serial},
+      ppu{other.ppu},
+      bus{other.bus} {
+    connect();
+}
+
+System &System::operator=(const System &other) {
+    if (this == &other) {
+        return *this;
+    }
+    cpu = other.cpu;
+    int_obs = other.int_obs;
+    joypad = other.joypad;
+    timer = other.timer;
+    serial = other.serial;
+    ppu = other.ppu;
+    bus = other.bus;
+    connect();
+    return *this;
+}
+
+void System::connect() {
+    cpu.connect_bus(&bus);
+    cpu.connect_interrupt_observer(&int_obs);
+    ppu.connect_bus(&bus);
+    ppu.connect_interrupt_observer(&int_obs);
+    joypad.connect_interrupt_observer(&int_obs);
+    timer.connect_interrupt_observer(&int_obs);
+    serial.connect_interrupt_observer(&int_obs);
+
+    bus.connect_interrupt_observer(&int_obs);
+    bus.connect_joypad(&joypad);
+    bus.connect_timer(&timer);
+    bus.connect_serial(&serial);
+    bus.connect_ppu(&ppu);
+}
+
+void System::reset() {
+    cpu.reset();
+    // resets the other components too
+    bus.reset();
+}
+
+void System::load_cart(std::unique_ptr<Cartridge> cart) {
+    bus.load_cart(std::move(cart));
+}
+
+void System::restore(const System &snapshot) {
+    TraceWriter *trace = cpu.trace();
+    SerialSink *sink = serial.sink();
+    HostInput *host = joypad.host_input();
+    bool rendering = ppu.rendering();
+    bool indexed = ppu.indexed();
+    *this = snapshot;
+    cpu.attach_trace(trace);
+    serial.connect_sink(sink);
+    joypad.connect_host_input(host);
+    ppu.set_rendering(rendering);
+    ppu.set_indexed(indexed);
+}
+
+bool System::run_frame() {
+    int cycle_count = 0;
+    while (cycle_count < dmg::CYCLES_PER_FRAME) {
+        int cycles_ran = cpu.step(dmg::CYCLE_STEP);
+        cycle_count += cycles_ran;
+        if (step_components(cycles_ran)) {
+            return true;
+        }
+    }
+    // no frame with the lcd off, the buttons still need a new frame
+    joypad.start_frame();
+    return false;
+}
+
+bool System::run_until(uint64_t cycle) {
+    bool frame_done = false;
+    while (cpu.cycles() < cycle) {
+        uint64_t left = cycle - cpu.cycles();
+        int cycles = static_cast<int>(std::min<uint64_t>(dmg::CYCLE_STEP, left));
+        // a halted cpu would otherwise jump ahead to the next interrupt
+        int max_cycles = static_cast<int>(std::min<uint64_t>(std::numeric_limits<int>::max(), left));
+        frame_done |= step_components(cpu.step(cycles, max_cycles));
+    }
+    return frame_done;
+}
+
+bool System::step_components(int cycles) {
+    timer.step(cycles);
+    serial.step(cycles);
+    if (!ppu.step(cycles)) {
+        return false;
+    }
+    joypad.start_frame();
+    return true;
+}
@@ -1,6 +1,8 @@
+#include <limits>
 #include <memory>
 
 #include "InterruptObserver.h"
+#include "MemoryBus.h"
 #include "Timer.h"
 
 void Timer::reset() {
@@ -14,10 +16,18 @@ void Timer::reset() {
     m_cycles_until_next_tima = 0;
 }
 
-void Timer::connect_interrupt_observer(std::shared_ptr<InterruptObserver> int_obs) {
+void Timer::connect_interrupt_observer(InterruptObserver *int_obs) {
     m_int_obs = int_obs;
 }
 
+void Timer::register_io_handlers(MemoryBus &bus) {
+    auto read = [](void *ctx, uint16_t addr) { return static_cast<Timer *>(ctx)->read_byte(addr); };
+    auto write = [](void *ctx, uint16_t addr, uint8_t val) { static_cast<Timer *>(ctx)->write_byte(addr, val); };
+    for (uint16_t addr : {DIV_ADDR, TIMA_ADDR, TMA_ADDR, TAC_ADDR}) {
+        bus.register_io_handler(addr, IoHandler{read, write, this});
+    }
+}
+
 uint8_t Timer::read_byte(uint16_t addr) {
     switch(addr) {
         case DIV_ADDR: return (uint8_t)(m_div >> 8);
@@ -61,6 +71,31 @@ void Timer::write_byte(uint16_t addr, uint8_t val) {
     }
 }
 
+int Timer::cycles_until_interrupt() const {
+    if (m_tima_overflow) {
+        return 1;
+    }
+    if (!m_timer_enabled) {
+        return std::numeric_limits<int>::max();
+    }
+    // cycles until tima overflows, the interrupt follows one cycle later
+    int next_tick = m_tima_freq - m_cycles_until_next_tima;
+    return next_tick + (0xFF - m_tima) * m_tima_freq + 1;
+}
+
+int Timer::cycles_until_div_change() const {
+    // DIV reads the upper byte of m_div
+    int next_tick = DIV_FREQ - m_cycles_until_next_div;
+    return next_tick + (0xFF - (m_div & 0xFF)) * DIV_FREQ;
+}
+
+int Timer::cycles_until_tima_change() const {
+    if (!m_timer_enabled) {
+        return std::numeric_limits<int>::max();
+    }
+    return m_tima_freq - m_cycles_until_next_tima;
+}
+
 void Timer::step(int cycles) {
     uint8_t old_tima = m_tima;
     for(int i = 0; i < cycles; ++i) {
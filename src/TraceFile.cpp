@@ -0,0 +1,167 @@
+#include "TraceFile.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char HEX[] = "0123456789ABCDEF";
+
+char *put_field(char *out, const char *label, uint8_t value) {
+	while (*label) { *out++ = *label++; }
+	*out++ = HEX[value >> 4];
+	*out++ = HEX[value & 0xF];
+	return out;
+}
+
+}
+
+size_t format_doctor_line(const TraceRecord &record, char *out, bool with_bank) {
+	// built by hand, printf would be most of the time spent decoding a trace
+	char *p = out;
+	p = put_field(p, "A:", record.a);
+	p = put_field(p, " F:", record.f);
+	p = put_field(p, " B:", record.b);
+	p = put_field(p, " C:", record.c);
+	p = put_field(p, " D:", record.d);
+	p = put_field(p, " E:", record.e);
+	p = put_field(p, " H:", record.h);
+	p = put_field(p, " L:", record.l);
+	p = put_field(p, " SP:", record.sp >> 8);
+	p = put_field(p, "", record.sp & 0xFF);
+	if (with_bank) {
+		p = put_field(p, " PC:", record.bank & 0xFF);
+		p = put_field(p, ":", record.pc >> 8);
+	} else {
+		p = put_field(p, " PC:", record.pc >> 8);
+	}
+	p = put_field(p, "", record.pc & 0xFF);
+	p = put_field(p, " PCMEM:", record.pc_mem[0]);
+	p = put_field(p, ",", record.pc_mem[1]);
+	p = put_field(p, ",", record.pc_mem[2]);
+	p = put_field(p, ",", record.pc_mem[3]);
+	return p - out;
+}
+
+//-----------------------------------------------------
+// TraceWriter
+//-----------------------------------------------------
+TraceWriter::~TraceWriter() {
+	close();
+}
+
+bool TraceWriter::open(const std::string &filename, size_t capacity) {
+	close();
+	size_t records = 1;
+	while (records < capacity) { records <<= 1; }
+	size_t size = sizeof(TraceFileHeader) + records * sizeof(TraceRecord);
+
+	int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	// the file stays sparse until the ring actually fills up
+	if (ftruncate(fd, size) != 0) {
+		::close(fd);
+		return false;
+	}
+	void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED) {
+		return false;
+	}
+
+	m_header = static_cast<TraceFileHeader *>(mem);
+	std::memcpy(m_header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+	m_header->record_size = sizeof(TraceRecord);
+	m_header->capacity = records;
+	m_header->count = 0;
+	m_records = reinterpret_cast<TraceRecord *>(m_header + 1);
+	m_mask = records - 1;
+	m_mapped_size = size;
+	return true;
+}
+
+void TraceWriter::close() {
+	if (m_header == nullptr) {
+		return;
+	}
+	munmap(m_header, m_mapped_size);
+	m_header = nullptr;
+	m_records = nullptr;
+	m_mapped_size = 0;
+}
+
+//-----------------------------------------------------
+// TraceReader
+//-----------------------------------------------------
+TraceReader::~TraceReader() {
+	close();
+}
+
+bool TraceReader::open(const std::string &filename) {
+	close();
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TraceFileHeader)) {
+		::close(fd);
+		return false;
+	}
+	size_t size = st.st_size;
+	void *mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mem == MAP_FAILED) {
+		return false;
+	}
+
+	const auto *header = static_cast<const TraceFileHeader *>(mem);
+	uint64_t capacity = header->capacity;
+	bool valid = std::memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0
+		&& header->record_size == sizeof(TraceRecord)
+		&& capacity != 0 && (capacity & (capacity - 1)) == 0
+		&& sizeof(TraceFileHeader) + capacity * sizeof(TraceRecord) <= size;
+	if (!valid) {
+		munmap(mem, size);
+		return false;
+	}
+
+	m_header = header;
+	m_records = reinterpret_cast<const TraceRecord *>(header + 1);
+	m_mask = capacity - 1;
+	m_size = header->count < capacity ? header->count : capacity;
+	m_first = header->count - m_size;
+	m_mapped_size = size;
+	return true;
+}
+
+void TraceReader::close() {
+	if (m_header == nullptr) {
+		return;
+	}
+	munmap(const_cast<TraceFileHeader *>(m_header), m_mapped_size);
+	m_header = nullptr;
+	m_records = nullptr;
+	m_size = 0;
+	m_mapped_size = 0;
+}
+
+const TraceRecord *TraceReader::first_run(size_t &len) const {
+	size_t start = m_first & m_mask;
+	size_t until_wrap = m_mask + 1 - start;
+	len = m_size < until_wrap ? m_size : until_wrap;
+	return m_records + start;
+}
+
+const TraceRecord *TraceReader::second_run(size_t &len) const {
+	size_t first_len = 0;
+	first_run(first_len);
+	len = m_size - first_len;
+	return m_records;
+}
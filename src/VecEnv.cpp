@@ -0,0 +1,156 @@
+#include "VecEnv.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr size_t SHADE_BYTES = dmg::WIDTH * dmg::HEIGHT;
+constexpr size_t FRAME_BYTES = SHADE_BYTES * sizeof(uint32_t);
+
+}
+
+VecEnv::VecEnv(RomImage rom, int count, VecEnvObservation observation, int threads)
+    : m_pool{std::move(rom)}, m_envs(count > 0 ? count : 0), m_observation{observation} {
+    // draw shades unless only colors are observed, colors for the frame
+    // section are filled in as it is copied out
+    bool indexed = m_observation.shades || !m_observation.frame;
+    for (System &env : m_envs) {
+        env.ppu.set_rendering(m_observation.frame || m_observation.shades || m_observation.stacked);
+        env.ppu.set_indexed(indexed);
+        m_pool.restore(env);
+    }
+    if (m_observation.stacked) {
+        ObservationPipeline pipeline{m_observation.stacking};
+        m_observation.stacking = pipeline.config();
+        m_pipelines.assign(m_envs.size(), pipeline);
+    }
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    // no point in more threads than envs
+    for (int i = 1; i < threads && i < size(); ++i) {
+        m_workers.emplace_back([this] { worker(); });
+    }
+}
+
+VecEnv::~VecEnv() {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void VecEnv::reset(int env, int slot) {
+    m_pool.restore(m_envs.at(env), slot);
+    if (m_observation.stacked) {
+        m_pipelines[env].clear();
+    }
+}
+
+void VecEnv::reset_all(int slot) {
+    parallel([this, slot](int env) { reset(env, slot); });
+}
+
+void VecEnv::step(const uint8_t *buttons, int frames, void *observations) {
+    auto *out = static_cast<uint8_t *>(observations);
+    parallel([this, buttons, frames, out](int env) {
+        System &system = m_envs[env];
+        system.joypad.set_buttons(buttons[env]);
+        bool frame_done = false;
+        for (int i = 0; i < frames; ++i) {
+            frame_done |= system.run_frame();
+        }
+        if (frame_done && m_observation.stacked) {
+            if (system.ppu.indexed()) {
+                m_pipelines[env].push(system.ppu.get_shade_buffer());
+            } else {
+                m_pipelines[env].push(system.ppu.get_frame_buffer());
+            }
+        }
+        write_observation(env, out);
+    });
+}
+
+void VecEnv::observe(void *observations) {
+    auto *out = static_cast<uint8_t *>(observations);
+    parallel([this, out](int env) { write_observation(env, out); });
+}
+
+size_t VecEnv::observation_bytes() const {
+    return ram_offset() + m_envs.size() * m_observation.ram_len;
+}
+
+size_t VecEnv::shade_offset() const {
+    return m_observation.frame ? m_envs.size() * FRAME_BYTES : 0;
+}
+
+size_t VecEnv::stack_offset() const {
+    return shade_offset() + (m_observation.shades ? m_envs.size() * SHADE_BYTES : 0);
+}
+
+size_t VecEnv::ram_offset() const {
+    const ObservationConfig &stacking = m_observation.stacking;
+    size_t stack_size = static_cast<size_t>(stacking.stack) * stacking.width * stacking.height;
+    return stack_offset() + (m_observation.stacked ? m_envs.size() * stack_size : 0);
+}
+
+void VecEnv::write_observation(int env, uint8_t *observations) {
+    System &system = m_envs[env];
+    if (m_observation.frame) {
+        std::memcpy(observations + env * FRAME_BYTES, system.ppu.get_frame_buffer(), FRAME_BYTES);
+    }
+    if (m_observation.shades) {
+        std::memcpy(observations + shade_offset() + env * SHADE_BYTES, system.ppu.get_shade_buffer(), SHADE_BYTES);
+    }
+    if (m_observation.stacked) {
+        const ObservationPipeline &pipeline = m_pipelines[env];
+        pipeline.write(observations + stack_offset() + env * pipeline.size());
+    }
+    uint8_t *ram = observations + ram_offset() + env * m_observation.ram_len;
+    for (int i = 0; i < m_observation.ram_len; ++i) {
+        ram[i] = system.bus.read_byte(static_cast<uint16_t>(m_observation.ram_addr + i));
+    }
+}
+
+void VecEnv::parallel(std::function<void(int)> job) {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_job = std::move(job);
+        m_next = 0;
+        m_busy = static_cast<int>(m_workers.size()) + 1;
+        ++m_generation;
+    }
+    m_wake.notify_all();
+    work();
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_done.wait(lock, [this] { return m_busy == 0; });
+}
+
+void VecEnv::worker() {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seen; });
+            if (m_stopping) {
+                return;
+            }
+            seen = m_generation;
+        }
+        work();
+    }
+}
+
+void VecEnv::work() {
+    for (int env = m_next++; env < size(); env = m_next++) {
+        m_job(env);
+    }
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (--m_busy == 0) {
+        m_done.notify_one();
+    }
+}
@@ -1,63 +1,46 @@
 #include "Window.h"
 
-void handle_key_pressed(sf::Event &event, JoyPad &joypad) {
-	switch (event.key.code) {
+bool key_to_input(sf::Keyboard::Key key, JoyPadInput &input) {
+	switch (key) {
 	case sf::Keyboard::W:
-		joypad.handle_press(JoyPadInput::UP);
-		break;
+		input = JoyPadInput::UP;
+		return true;
 	case sf::Keyboard::A:
-		joypad.handle_press(JoyPadInput::LEFT);
-		break;
+		input = JoyPadInput::LEFT;
+		return true;
 	case sf::Keyboard::S:
-		joypad.handle_press(JoyPadInput::DOWN);
-		break;
+		input = JoyPadInput::DOWN;
+		return true;
 	case sf::Keyboard::D:
-		joypad.handle_press(JoyPadInput::RIGHT);
-		break;
+		input = JoyPadInput::RIGHT;
+		return true;
 	case sf::Keyboard::LControl:
-		joypad.handle_press(JoyPadInput::START);
-		break;
+		input = JoyPadInput::START;
+		return true;
 	case sf::Keyboard::Space:
-		joypad.handle_press(JoyPadInput::SELECT);
-		break;
+		input = JoyPadInput::SELECT;
+		return true;
 	case sf::Keyboard::J:
-		joypad.handle_press(JoyPadInput::A);
-		break;
+		input = JoyPadInput::A;
+		return true;
 	case sf::Keyboard::K:
-		joypad.handle_press(JoyPadInput::B);
-		break;
+		input = JoyPadInput::B;
+		return true;
 	default:
-		break;
+		return false;
 	}
 }
 
-void handle_key_released(sf::Event &event, JoyPad &joypad) {
-	switch (event.key.code) {
-	case sf::Keyboard::W:
-		joypad.handle_press(JoyPadInput::UP);
-		break;
-	case sf::Keyboard::A:
-		joypad.handle_press(JoyPadInput::LEFT);
-		break;
-	case sf::Keyboard::S:
-		joypad.handle_press(JoyPadInput::DOWN);
-		break;
-	case sf::Keyboard::D:
-		joypad.handle_press(JoyPadInput::RIGHT);
-		break;
-	case sf::Keyboard::LControl:
-		joypad.handle_press(JoyPadInput::START);
-		break;
-	case sf::Keyboard::Space:
-		joypad.handle_press(JoyPadInput::SELECT);
-		break;
-	case sf::Keyboard::J:
-		joypad.handle_press(JoyPadInput::A);
-		break;
-	case sf::Keyboard::K:
-		joypad.handle_press(JoyPadInput::B);
-		break;
-	default:
-		break;
+void handle_key_pressed(sf::Event &event, HostInput &host) {
+	JoyPadInput input;
+	if (key_to_input(event.key.code, input)) {
+		host.press(input);
+	}
+}
+
+void handle_key_released(sf::Event &event, HostInput &host) {
+	JoyPadInput input;
+	if (key_to_input(event.key.code, input)) {
+		host.release(input);
 	}
 }
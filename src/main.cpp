@@ -4,6 +4,7 @@
 #include <iostream>
 #include <memory>
 #include <random>
+#include <stdexcept>
 #include <vector>
 
 // external dependencies
@@ -12,14 +13,43 @@
 
 // dmg Headers
 #include "Cartridge.h"
-#include "Cpu.h"
-#include "MemoryBus.h"
-#include "InterruptObserver.h"
-#include "JoyPad.h"
-#include "Ppu.h"
-#include "Timer.h"
+#include "HostInput.h"
+#include "Netplay.h"
+#include "RunAhead.h"
+#include "System.h"
+#include "TraceFile.h"
 #include "Window.h"
 
+namespace {
+
+// what the event pump needs, handed to it as the poll callback's ctx
+struct EventPump {
+	sf::RenderWindow &window;
+	HostInput &input;
+	bool &running;
+};
+
+void pump_events(void *ctx) {
+	auto &pump = *static_cast<EventPump *>(ctx);
+	sf::Event event;
+	while (pump.window.pollEvent(event)) {
+		switch (event.type) {
+			case sf::Event::Closed:
+				pump.running = false;
+				break;
+			case sf::Event::KeyPressed:
+				handle_key_pressed(event, pump.input);
+				break;
+			case sf::Event::KeyReleased:
+				handle_key_released(event, pump.input);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+}
 
 int main(int argc, char **argv) {
 	 
@@ -32,62 +62,112 @@ int main(int argc, char **argv) {
 	sf::Sprite bgsprite;
 
 	// dmg objects
-	Cpu cpu{};
-	std::shared_ptr<MemoryBus> bus = std::make_shared<MemoryBus>();
-	std::shared_ptr<InterruptObserver> int_obs = std::make_shared<InterruptObserver>();
-	std::shared_ptr<JoyPad> joypad = std::make_shared<JoyPad>();
-	std::shared_ptr<Timer> timer = std::make_shared<Timer>();
-	std::shared_ptr<Ppu> ppu = std::make_shared<Ppu>();
-
-	cpu.connect_bus(bus);
-	ppu->connect_bus(bus);
-	bus->connect_joypad(joypad);
-	bus->connect_timer(timer);
-	bus->connect_ppu(ppu);
+	System gb{};
+	TraceWriter trace{};
+	std::string trace_name{};
+	size_t trace_records{ TRACE_DEFAULT_RECORDS };
+	// the keys the player holds, the game samples them when it reads JOYP
+	HostInput input{};
+	// netplay runs the peer's gameboy here too and sends the buttons every frame
+	System peer{};
+	std::unique_ptr<Netplay> netplay{};
+	std::string netplay_address{};
+	std::string peer_rom{};
+	bool netplay_host{ false };
+	NetplaySettings settings{};
+	int run_ahead_frames{ 0 };
 
-	bus->connect_interrupt_observer(int_obs);
-	joypad->connect_interrupt_observer(int_obs);
-	timer->connect_interrupt_observer(int_obs);
-	ppu->connect_interrupt_observer(int_obs);
-
-	
 	// control flags
 	bool running{ true };
 	bool rom_loaded{ false };
 	bool draw_frame { false };
-	sf::Event event;
+	EventPump pump{game_window, input, running};
 
 	// reset the system
-	cpu.reset();
-	bus->reset();
-	joypad->reset();
-	int_obs->reset();
-	timer->reset();
-	if (argc > 1) { 
-		const std::string rom_name {argv[1]};
-		bus->load_cart(system_load_rom(rom_name));
-	} else {
-		bus->load_cart(system_load_rom("./roms/dmg-acid2.gb"));
+	gb.reset();
+	std::string rom_name{"./roms/dmg-acid2.gb"};
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg{argv[i]};
+		if (arg == "--no-idle-skip") {
+			// with netplay the host's choice goes for both players' systems
+			settings.idle_skip = false;
+		} else if (arg == "--trace" && i + 1 < argc) {
+			// binary per instruction trace, decode it with trace_decode. The
+			// file is a ring, past --trace-records instructions the oldest
+			// are overwritten
+			trace_name = argv[++i];
+		} else if (arg == "--trace-records" && i + 1 < argc) {
+			// instructions the trace keeps, rounded up to a power of 2 at
+			// 32 bytes each, defaults to 4M
+			const std::string count{argv[++i]};
+			try {
+				size_t used = 0;
+				trace_records = std::stoull(count, &used);
+				if (used != count.size() || count[0] == '-' || trace_records == 0) {
+					throw std::invalid_argument(count);
+				}
+			} catch (const std::exception &) {
+				fmt::print("--trace-records needs a positive number of instructions, got {}\n", count);
+				return 1;
+			}
+		} else if (arg == "--run-ahead" && i + 1 < argc) {
+			// frames to run ahead of the system, 1 or 2 hide most games' input lag
+			run_ahead_frames = std::stoi(argv[++i]);
+		} else if ((arg == "--netplay-host" || arg == "--netplay-join") && i + 2 < argc) {
+			// <host:port or socket path> <the peer's rom>
+			netplay_host = arg == "--netplay-host";
+			netplay_address = argv[++i];
+			peer_rom = argv[++i];
+		} else {
+			rom_name = arg;
+		}
 	}
+	if (!trace_name.empty()) {
+		if (!trace.open(trace_name, trace_records)) {
+			fmt::print("Failed to open trace file {}\n", trace_name);
+			return 1;
+		}
+		gb.cpu.attach_trace(&trace);
+	}
+	gb.cpu.set_idle_skip(settings.idle_skip);
+	gb.load_cart(system_load_rom(rom_name));
 	rom_loaded = true;
+	// netplay already predicts and rolls back, it doesn't run ahead as well
+	RunAhead run_ahead{gb, netplay_address.empty() ? run_ahead_frames : 0};
+
+	if (!netplay_address.empty()) {
+		NetSocket socket{};
+		fmt::print("Waiting for the other player on {}\n", netplay_address);
+		bool connected = netplay_host ? socket.listen(netplay_address) : socket.connect(netplay_address);
+		if (!connected) {
+			fmt::print("Failed to reach the other player on {}\n", netplay_address);
+			return 1;
+		}
+		if (!netplay_handshake(socket, netplay_host, settings)) {
+			fmt::print("The other player on {} isn't running a compatible Microboy\n", netplay_address);
+			return 1;
+		}
+		gb.cpu.set_idle_skip(settings.idle_skip);
+		peer.reset();
+		peer.load_cart(system_load_rom(peer_rom));
+		peer.cpu.set_idle_skip(settings.idle_skip);
+		// both sides order the systems host first
+		System &left = netplay_host ? gb : peer;
+		System &right = netplay_host ? peer : gb;
+		netplay = std::make_unique<Netplay>(left, right, netplay_host ? 0 : 1, std::move(socket));
+		game_window.setFramerateLimit(dmg::FRAMERATE);
+	} else {
+		// pump the window's events when the game reads the buttons, not just
+		// once before the frame
+		gb.joypad.connect_host_input(&input);
+		input.set_poll_callback(pump_events, &pump);
+	}
 
 	// game loop
 	while (running) {
-		while (game_window.pollEvent(event)) {
-			if (event.type == sf::Event::Closed) {
-				running = false;
-				break;
-			}
-			switch (event.type) {
-				case sf::Event::KeyPressed:
-					handle_key_pressed(event, *joypad);
-					break;
-				case sf::Event::KeyReleased:
-					handle_key_released(event, *joypad);
-					break;
-				default:
-					break;
-			}
+		pump_events(&pump);
+		if (!running) {
+			break;
 		}
 
 		// run gameboy only if game is loaded
@@ -96,21 +176,21 @@ int main(int argc, char **argv) {
 			break;
 		}
 
-		int cycle_count = 0;
-		
-		while (cycle_count < dmg::CYCLES_PER_FRAME) {
-			int cycles_ran = cpu.step(dmg::CYCLE_STEP);
-			cycle_count += cycles_ran;
-			timer->step(cycles_ran);
-			draw_frame = ppu->step(cycles_ran);
-			if (draw_frame) break;
+		if (netplay) {
+			if (!netplay->run_frame(input.buttons())) {
+				fmt::print("The other player disconnected\n");
+				break;
+			}
+			draw_frame = true;
+		} else {
+			draw_frame = run_ahead.run_frame();
 		}
-		cycle_count = 0;
 		// Render
 		if (draw_frame) {
 			game_window.clear();
 			// update texture
-			bg_texture.update((const uint8_t *) ppu->get_frame_buffer());
+			uint32_t *frame_buffer = netplay ? netplay->local().ppu.get_frame_buffer() : run_ahead.get_frame_buffer();
+			bg_texture.update((const uint8_t *) frame_buffer);
 			bgsprite.setTexture(bg_texture);
 			game_window.draw(bgsprite);
 			game_window.display();
@@ -121,5 +201,11 @@ int main(int argc, char **argv) {
 	}
 
 	game_window.close();
+	fmt::print("Idle loops skipped: {} ({} cycles)\n", gb.cpu.idle_loops_skipped(), gb.cpu.idle_cycles_skipped());
+	if (netplay) {
+		const NetplayStats &stats = netplay->stats();
+		fmt::print("Rollbacks: {} ({} frames, longest {:.2f} ms), stalls: {}\n",
+			stats.rollbacks, stats.frames_resimulated, stats.max_rollback_ms, stats.stalls);
+	}
 	return 0;
 }
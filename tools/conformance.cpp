@@ -0,0 +1,211 @@
+// Runs a set of test roms in parallel and reports which ones pass. Each rom
+// stops as soon as it reports a result:
+//     Blargg   prints "Passed" or "Failed" over the serial port
+//     Mooneye  runs LD B,B with B,C,D,E,H,L = 3,5,8,13,21,34 to pass or all
+//              0x42 to fail
+// Roms that report nothing within the timeout count as timed out. Results
+// are checked after every frame.
+// usage: conformance [--jobs N] [--timeout SECONDS] <rom|directory>...
+//     --jobs     worker threads, defaults to one per core
+//     --timeout  emulated seconds per rom, defaults to 120
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Cartridge.h"
+#include "System.h"
+
+namespace {
+
+enum class Outcome { PASS, FAIL, TIMEOUT, ERROR };
+
+const char *outcome_name(Outcome outcome) {
+	switch (outcome) {
+	case Outcome::PASS: return "PASS";
+	case Outcome::FAIL: return "FAIL";
+	case Outcome::TIMEOUT: return "TIMEOUT";
+	case Outcome::ERROR: return "ERROR";
+	}
+	return "";
+}
+
+struct Result {
+	Outcome outcome{Outcome::ERROR};
+	int frames{0};
+	double seconds{0};
+	std::string serial;
+};
+
+// keeps everything the rom sends, the other side of the cable reads 0xFF
+class CaptureSink : public SerialSink {
+public:
+	uint8_t transfer(uint8_t out) override {
+		m_text += static_cast<char>(out);
+		m_changed = true;
+		return 0xFF;
+	}
+	// true once per batch of new bytes
+	bool changed() {
+		bool changed = m_changed;
+		m_changed = false;
+		return changed;
+	}
+	const std::string &text() const { return m_text; }
+
+private:
+	std::string m_text;
+	bool m_changed{false};
+};
+
+// Mooneye reports through the registers at a LD B,B breakpoint
+bool mooneye_result(Cpu &cpu, Outcome &outcome) {
+	static constexpr uint8_t PASS_REGS[]{3, 5, 8, 13, 21, 34};
+	static constexpr RegisterName8Bit REGS[]{B, C, D, E, H, L};
+	bool pass = true;
+	bool fail = true;
+	for (int i = 0; i < 6; ++i) {
+		uint8_t value = cpu.read_byte(REGS[i]);
+		pass = pass && value == PASS_REGS[i];
+		fail = fail && value == 0x42;
+	}
+	if (pass || fail) {
+		outcome = pass ? Outcome::PASS : Outcome::FAIL;
+		return true;
+	}
+	return false;
+}
+
+Result run_rom(const std::string &filename, int max_frames) {
+	auto start = std::chrono::steady_clock::now();
+	Result result;
+	auto cart = system_load_rom(filename);
+	if (!cart) {
+		return result;
+	}
+
+	System gb{};
+	CaptureSink sink;
+	gb.reset();
+	gb.load_cart(std::move(cart));
+	gb.serial.connect_sink(&sink);
+
+	result.outcome = Outcome::TIMEOUT;
+	while (result.frames < max_frames) {
+		gb.run_frame();
+		++result.frames;
+		if (sink.changed()) {
+			const std::string &text = sink.text();
+			if (text.find("Passed") != std::string::npos) {
+				result.outcome = Outcome::PASS;
+				break;
+			}
+			if (text.find("Failed") != std::string::npos) {
+				result.outcome = Outcome::FAIL;
+				break;
+			}
+		}
+		if (gb.cpu.debug_break()) {
+			gb.cpu.clear_debug_break();
+			if (mooneye_result(gb.cpu, result.outcome)) {
+				break;
+			}
+		}
+	}
+	result.serial = sink.text();
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+// the roms named on the command line, directories are searched for .gb files
+std::vector<std::string> collect_roms(const std::vector<std::string> &paths) {
+	namespace fs = std::filesystem;
+	std::vector<std::string> roms;
+	for (const std::string &path : paths) {
+		std::error_code error;
+		if (!fs::is_directory(path, error)) {
+			roms.push_back(path);
+			continue;
+		}
+		std::vector<std::string> found;
+		for (const auto &entry : fs::recursive_directory_iterator(path, error)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".gb") {
+				found.push_back(entry.path().string());
+			}
+		}
+		std::sort(found.begin(), found.end());
+		roms.insert(roms.end(), found.begin(), found.end());
+	}
+	return roms;
+}
+
+// last non-empty line of the serial output, enough to see why a test failed
+std::string last_line(const std::string &text) {
+	size_t end = text.find_last_not_of("\r\n");
+	if (end == std::string::npos) {
+		return "";
+	}
+	size_t start = text.find_last_of('\n', end);
+	start = start == std::string::npos ? 0 : start + 1;
+	return text.substr(start, end - start + 1);
+}
+
+}
+
+int main(int argc, char **argv) {
+	std::vector<std::string> paths;
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+	double timeout = 120;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg{argv[i]};
+		if (arg == "--jobs" && i + 1 < argc) {
+			jobs = std::max(1, std::stoi(argv[++i]));
+		} else if (arg == "--timeout" && i + 1 < argc) {
+			timeout = std::stod(argv[++i]);
+		} else {
+			paths.push_back(arg);
+		}
+	}
+	std::vector<std::string> roms = collect_roms(paths);
+	if (roms.empty()) {
+		std::fprintf(stderr, "usage: %s [--jobs N] [--timeout SECONDS] <rom|directory>...\n", argv[0]);
+		return 2;
+	}
+	int max_frames = static_cast<int>(timeout * dmg::CPU_SPEED / dmg::CYCLES_PER_FRAME);
+
+	// every worker takes the next rom until there are none left
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Result> results(roms.size());
+	std::atomic<size_t> next{0};
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < std::min<size_t>(jobs, roms.size()); ++i) {
+		workers.emplace_back([&] {
+			for (size_t rom = next++; rom < roms.size(); rom = next++) {
+				results[rom] = run_rom(roms[rom], max_frames);
+			}
+		});
+	}
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int counts[4]{};
+	for (size_t i = 0; i < roms.size(); ++i) {
+		const Result &r = results[i];
+		++counts[static_cast<int>(r.outcome)];
+		std::printf("%-7s %7.2fs %6d frames  %s", outcome_name(r.outcome), r.seconds, r.frames, roms[i].c_str());
+		if (r.outcome != Outcome::PASS && !r.serial.empty()) {
+			std::printf("  \"%s\"", last_line(r.serial).c_str());
+		}
+		std::printf("\n");
+	}
+	std::printf("%d passed, %d failed, %d timed out, %d errors in %.2fs on %u threads\n",
+		counts[0], counts[1], counts[2], counts[3], wall, std::min<unsigned>(jobs, roms.size()));
+	return counts[0] == static_cast<int>(roms.size()) ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// Checks that idle loop skipping doesn't change what a game sees when the
+// system is driven in uneven run_until slices, the way the link cable,
+// netplay and run ahead drive it. A built in rom counts LY reaching 0x90:
+//     wait: LDH A,(44); CP 90; JR NZ,wait
+//     held: LDH A,(44); CP 90; JR Z,held
+//           INC DE; JR wait
+// It runs once with idle skipping and once without, both cut into the same
+// random slices, and the counts in DE have to match.
+// usage: idle_skip_check [--cycles N] [--seed N]
+//     --cycles  cycles to run, defaults to 7000000
+//     --seed    seed for the slice lengths, defaults to 1
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Cartridge.h"
+#include "System.h"
+
+namespace {
+
+RomImage counting_rom() {
+	std::vector<uint8_t> rom(0x8000, 0x00);
+	// entry point: NOP; JP 0150
+	const uint8_t entry[]{ 0x00, 0xC3, 0x50, 0x01 };
+	const uint8_t code[]{
+		0x11, 0x00, 0x00,	// LD DE,0000
+		0xF0, 0x44,			// wait: LDH A,(44)
+		0xFE, 0x90,			// CP 90
+		0x20, 0xFA,			// JR NZ,wait
+		0xF0, 0x44,			// held: LDH A,(44)
+		0xFE, 0x90,			// CP 90
+		0x28, 0xFA,			// JR Z,held
+		0x13,				// INC DE
+		0x18, 0xF1,			// JR wait
+	};
+	std::copy(std::begin(entry), std::end(entry), rom.begin() + 0x100);
+	std::copy(std::begin(code), std::end(code), rom.begin() + 0x150);
+	return std::make_shared<const std::vector<uint8_t>>(std::move(rom));
+}
+
+struct Run {
+	uint16_t count{0};
+	uint64_t loops_skipped{0};
+};
+
+Run run(const RomImage &rom, bool idle_skip, uint64_t cycles, unsigned seed) {
+	auto gb = std::make_unique<System>();
+	gb->reset();
+	gb->load_cart(make_cartridge(rom));
+	gb->cpu.set_idle_skip(idle_skip);
+	std::mt19937 rng{seed};
+	while (gb->cpu.cycles() < cycles) {
+		gb->run_until(gb->cpu.cycles() + 1 + rng() % 1024);
+	}
+	return Run{gb->cpu.read_word(DE), gb->cpu.idle_loops_skipped()};
+}
+
+}
+
+int main(int argc, char **argv) {
+	uint64_t cycles = 7000000;
+	unsigned seed = 1;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg{argv[i]};
+		try {
+			if (arg == "--cycles" && i + 1 < argc) {
+				cycles = std::stoull(argv[++i]);
+			} else if (arg == "--seed" && i + 1 < argc) {
+				seed = std::stoul(argv[++i]);
+			} else {
+				throw std::invalid_argument(arg);
+			}
+		} catch (const std::exception &) {
+			std::fprintf(stderr, "usage: %s [--cycles N] [--seed N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	RomImage rom = counting_rom();
+	Run reference = run(rom, false, cycles, seed);
+	Run skipped = run(rom, true, cycles, seed);
+	std::printf("without idle skip: %u, with idle skip: %u (%llu loops skipped)\n",
+		reference.count, skipped.count, static_cast<unsigned long long>(skipped.loops_skipped));
+	if (skipped.count != reference.count) {
+		std::printf("FAIL\n");
+		return 1;
+	}
+	std::printf("PASS\n");
+	return 0;
+}
@@ -0,0 +1,280 @@
+// Runs single step instruction tests (the SingleStepTests sm83 json format)
+// against the cpu on a TraceBus, one instruction per test:
+//     [{"name": "00 0000", "initial": {"pc": 256, "sp": 65534, "a": 1, ...,
+//       "ime": 0, "ie": 0, "ram": [[256, 0], ...]}, "final": {...},
+//       "cycles": [[256, 0, "r-m"], ...]}, ...]
+// Registers, ime and the listed ram have to match the final state. The cpu
+// runs EI's next instruction right away, so EI tests fail on ime.
+// usage: sm83_step [--prefetch] [--writes] [--verbose] <test.json>...
+//     --prefetch  the final pc counts the fetch of the next opcode, compare
+//                 one less
+//     --writes    the bus writes also have to match the test's cycles
+//     --verbose   print every mismatch, not just the first test's
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Cpu.h"
+#include "TraceBus.h"
+
+namespace {
+
+// just enough json for the tests: objects, arrays, numbers, strings, null
+struct Json {
+	enum class Type { NONE, NUMBER, STRING, ARRAY, OBJECT };
+	Type type{Type::NONE};
+	long number{0};
+	std::string text;
+	std::vector<Json> items;
+	std::vector<std::string> keys;
+
+	const Json *get(const std::string &key) const {
+		for (size_t i = 0; i < keys.size(); ++i) {
+			if (keys[i] == key) { return &items[i]; }
+		}
+		return nullptr;
+	}
+	long num(const std::string &key) const {
+		const Json *value = get(key);
+		return value != nullptr ? value->number : 0;
+	}
+};
+
+class JsonParser {
+public:
+	explicit JsonParser(const std::string &text) : m_text(text) {}
+
+	bool parse(Json &out) {
+		return value(out) && (skip_space(), m_pos == m_text.size());
+	}
+
+private:
+	void skip_space() {
+		while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) { ++m_pos; }
+	}
+	bool eat(char c) {
+		skip_space();
+		if (m_pos < m_text.size() && m_text[m_pos] == c) {
+			++m_pos;
+			return true;
+		}
+		return false;
+	}
+	bool string(std::string &out) {
+		if (!eat('"')) { return false; }
+		while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+			if (m_text[m_pos] == '\\') { ++m_pos; }
+			out += m_text[m_pos++];
+		}
+		return eat('"');
+	}
+	bool value(Json &out) {
+		skip_space();
+		if (m_pos >= m_text.size()) { return false; }
+		char c = m_text[m_pos];
+		if (c == '{') {
+			out.type = Json::Type::OBJECT;
+			++m_pos;
+			if (eat('}')) { return true; }
+			do {
+				out.keys.emplace_back();
+				out.items.emplace_back();
+				if (!string(out.keys.back()) || !eat(':') || !value(out.items.back())) { return false; }
+			} while (eat(','));
+			return eat('}');
+		}
+		if (c == '[') {
+			out.type = Json::Type::ARRAY;
+			++m_pos;
+			if (eat(']')) { return true; }
+			do {
+				out.items.emplace_back();
+				if (!value(out.items.back())) { return false; }
+			} while (eat(','));
+			return eat(']');
+		}
+		if (c == '"') {
+			out.type = Json::Type::STRING;
+			return string(out.text);
+		}
+		if (m_text.compare(m_pos, 4, "null") == 0) {
+			m_pos += 4;
+			return true;
+		}
+		size_t end = m_pos;
+		if (end < m_text.size() && m_text[end] == '-') { ++end; }
+		while (end < m_text.size() && std::isdigit(static_cast<unsigned char>(m_text[end]))) { ++end; }
+		if (end == m_pos) { return false; }
+		out.type = Json::Type::NUMBER;
+		out.number = std::stol(m_text.substr(m_pos, end - m_pos));
+		m_pos = end;
+		return true;
+	}
+
+	const std::string &m_text;
+	size_t m_pos{0};
+};
+
+struct Options {
+	bool prefetch{false};
+	bool writes{false};
+	bool verbose{false};
+};
+
+constexpr const char *REG8_NAMES[] = {"b", "c", "d", "e", "h", "l", "f", "a"};
+
+void load_state(BasicCpu<TraceBus> &cpu, TraceBus &bus, const Json &state) {
+	cpu.reset();
+	bus.reset();
+	for (int reg = B; reg <= A; ++reg) {
+		cpu.write_byte(static_cast<RegisterName8Bit>(reg), state.num(REG8_NAMES[reg]));
+	}
+	cpu.write_word(SP, state.num("sp"));
+	cpu.write_word(PC, state.num("pc"));
+	cpu.set_ime(state.num("ime") != 0);
+	bus.write_byte(0xFFFF, state.num("ie"));
+	if (const Json *ram = state.get("ram")) {
+		for (const Json &cell : ram->items) {
+			bus.write_byte(cell.items[0].number, cell.items[1].number);
+		}
+	}
+	bus.clear_accesses();
+}
+
+// returns the mismatches as text, empty if the test passed
+std::string check_state(BasicCpu<TraceBus> &cpu, TraceBus &bus, const Json &test, const Options &options) {
+	const Json &state = *test.get("final");
+	std::string errors;
+	char line[96];
+	auto expect = [&](const char *what, long actual, long expected) {
+		if (actual != expected) {
+			std::snprintf(line, sizeof(line), "  %s is %lX, expected %lX\n", what, actual, expected);
+			errors += line;
+		}
+	};
+	for (int reg = B; reg <= A; ++reg) {
+		expect(REG8_NAMES[reg], cpu.read_byte(static_cast<RegisterName8Bit>(reg)), state.num(REG8_NAMES[reg]));
+	}
+	expect("sp", cpu.read_word(SP), state.num("sp"));
+	expect("pc", cpu.read_word(PC), (state.num("pc") - options.prefetch) & 0xFFFF);
+	expect("ime", cpu.ime(), state.num("ime"));
+	if (const Json *ram = state.get("ram")) {
+		for (const Json &cell : ram->items) {
+			char what[16];
+			std::snprintf(what, sizeof(what), "[%04lX]", cell.items[0].number);
+			expect(what, bus.read_byte(cell.items[0].number), cell.items[1].number);
+		}
+	}
+
+	if (options.writes) {
+		std::vector<BusAccess> expected;
+		if (const Json *cycles = test.get("cycles")) {
+			for (const Json &cycle : cycles->items) {
+				if (cycle.items.size() == 3 && cycle.items[2].text.find('w') != std::string::npos) {
+					expected.push_back({static_cast<uint16_t>(cycle.items[0].number),
+						static_cast<uint8_t>(cycle.items[1].number), BusAccessType::WRITE});
+				}
+			}
+		}
+		std::vector<BusAccess> actual;
+		for (const BusAccess &access : bus.accesses()) {
+			if (access.type == BusAccessType::WRITE) { actual.push_back(access); }
+		}
+		bool same = actual.size() == expected.size();
+		for (size_t i = 0; same && i < actual.size(); ++i) {
+			same = actual[i].addr == expected[i].addr && actual[i].value == expected[i].value;
+		}
+		if (!same) {
+			errors += "  writes:";
+			for (const BusAccess &access : actual) {
+				std::snprintf(line, sizeof(line), " %04X=%02X", access.addr, access.value);
+				errors += line;
+			}
+			errors += ", expected:";
+			for (const BusAccess &access : expected) {
+				std::snprintf(line, sizeof(line), " %04X=%02X", access.addr, access.value);
+				errors += line;
+			}
+			errors += "\n";
+		}
+	}
+	return errors;
+}
+
+bool read_file(const std::string &filename, std::string &out) {
+	std::ifstream file{filename, std::ios::binary};
+	if (!file) { return false; }
+	std::stringstream text;
+	text << file.rdbuf();
+	out = text.str();
+	return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+	Options options;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg{argv[i]};
+		if (arg == "--prefetch") {
+			options.prefetch = true;
+		} else if (arg == "--writes") {
+			options.writes = true;
+		} else if (arg == "--verbose") {
+			options.verbose = true;
+		} else {
+			files.push_back(arg);
+		}
+	}
+	if (files.empty()) {
+		std::fprintf(stderr, "usage: %s [--prefetch] [--writes] [--verbose] <test.json>...\n", argv[0]);
+		return 1;
+	}
+
+	TraceBus bus;
+	BasicCpu<TraceBus> cpu;
+	cpu.connect_bus(&bus);
+	size_t total_passed = 0;
+	size_t total_failed = 0;
+	for (const std::string &filename : files) {
+		std::string text;
+		Json tests;
+		if (!read_file(filename, text) || !JsonParser{text}.parse(tests) || tests.type != Json::Type::ARRAY) {
+			std::fprintf(stderr, "%s is not a readable test file\n", filename.c_str());
+			return 1;
+		}
+		size_t passed = 0;
+		size_t failed = 0;
+		for (const Json &test : tests.items) {
+			const Json *initial = test.get("initial");
+			if (initial == nullptr || test.get("final") == nullptr) {
+				std::fprintf(stderr, "%s: test without initial or final state\n", filename.c_str());
+				return 1;
+			}
+			load_state(cpu, bus, *initial);
+			cpu.step(1);
+			std::string errors = check_state(cpu, bus, test, options);
+			if (errors.empty()) {
+				++passed;
+				continue;
+			}
+			if (failed == 0 || options.verbose) {
+				const Json *name = test.get("name");
+				std::printf("%s: %s failed\n%s", filename.c_str(), name != nullptr ? name->text.c_str() : "?", errors.c_str());
+			}
+			++failed;
+		}
+		std::printf("%s: %zu passed, %zu failed\n", filename.c_str(), passed, failed);
+		total_passed += passed;
+		total_failed += failed;
+	}
+	if (files.size() > 1) {
+		std::printf("total: %zu passed, %zu failed\n", total_passed, total_failed);
+	}
+	return total_failed == 0 ? 0 : 1;
+}
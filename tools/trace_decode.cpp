@@ -0,0 +1,93 @@
+// Decodes a binary instruction trace (see TraceFile.h) into Gameboy Doctor
+// text, one line per instruction:
+//     A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02
+// If the ring wrapped the first instructions are gone, stderr says how many.
+// usage: trace_decode <trace> [--bank] [--cycles] [--disasm]
+//     --bank    write the pc as bank:addr
+//     --cycles  append the cycle count
+//     --disasm  append the disassembled instruction
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "Disassembler.h"
+#include "TraceFile.h"
+
+namespace {
+
+char *put_str(char *out, const char *str) {
+	while (*str) { *out++ = *str++; }
+	return out;
+}
+
+char *put_u64(char *out, uint64_t value) {
+	char digits[20];
+	int n = 0;
+	do { digits[n++] = '0' + value % 10; value /= 10; } while (value != 0);
+	while (n > 0) { *out++ = digits[--n]; }
+	return out;
+}
+
+}
+
+int main(int argc, char **argv) {
+	std::string filename;
+	bool show_bank = false;
+	bool show_cycles = false;
+	bool show_disasm = false;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg{argv[i]};
+		if (arg == "--bank") {
+			show_bank = true;
+		} else if (arg == "--cycles") {
+			show_cycles = true;
+		} else if (arg == "--disasm") {
+			show_disasm = true;
+		} else {
+			filename = arg;
+		}
+	}
+	if (filename.empty()) {
+		std::fprintf(stderr, "usage: %s <trace> [--bank] [--cycles] [--disasm]\n", argv[0]);
+		return 1;
+	}
+
+	TraceReader trace;
+	if (!trace.open(filename)) {
+		std::fprintf(stderr, "%s is not a readable trace\n", filename.c_str());
+		return 1;
+	}
+
+	if (trace.dropped() > 0) {
+		std::fprintf(stderr, "trace wrapped, %llu records lost, the first line is instruction %llu\n",
+			static_cast<unsigned long long>(trace.dropped()), static_cast<unsigned long long>(trace.dropped() + 1));
+	}
+
+	// lines are built into one big buffer and written out in blocks
+	static char buffer[1 << 16];
+	constexpr size_t MAX_LINE = 128;
+	char *out = buffer;
+	for (size_t i = 0; i < trace.size(); ++i) {
+		const TraceRecord &r = trace[i];
+		out += format_doctor_line(r, out, show_bank);
+		if (show_cycles) {
+			out = put_str(out, " CY:");
+			out = put_u64(out, r.cycle);
+		}
+		if (show_disasm) {
+			char text[DISASSEMBLY_MAX];
+			disassemble(r.pc_mem, r.pc, text, sizeof(text));
+			*out++ = ' ';
+			out = put_str(out, text);
+		}
+		*out++ = '\n';
+
+		if (static_cast<size_t>(out - buffer) > sizeof(buffer) - MAX_LINE) {
+			std::fwrite(buffer, 1, out - buffer, stdout);
+			out = buffer;
+		}
+	}
+	std::fwrite(buffer, 1, out - buffer, stdout);
+	return 0;
+}
@@ -0,0 +1,292 @@
+// Finds the first line where a Microboy trace and a reference log disagree
+// and prints the lines around it. The reference is a Gameboy Doctor log, the
+// first file is either a binary trace (see TraceFile.h) or a second log.
+// Both are memory mapped and compared 16 bytes at a time. A trace whose ring
+// wrapped starts later than the log, the log lines for the overwritten
+// records are skipped and line numbers still count from the log's start.
+// usage: trace_diff <trace|log> <reference log> [--context N]
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "TraceFile.h"
+
+namespace {
+
+// read only mapping of a whole file
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	~MappedFile() {
+		if (m_size > 0) { munmap(const_cast<char *>(m_data), m_size); }
+	}
+
+	bool open(const std::string &filename) {
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		m_size = st.st_size;
+		if (m_size > 0) {
+			void *mem = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (mem == MAP_FAILED) {
+				m_size = 0;
+				::close(fd);
+				return false;
+			}
+			// both logs are read front to back once
+			madvise(mem, m_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const char *>(mem);
+		}
+		::close(fd);
+		return true;
+	}
+
+	const char *data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const char *m_data{nullptr};
+	size_t m_size{0};
+};
+
+// index of the first byte where a and b differ, len if they match
+size_t first_mismatch(const char *a, const char *b, size_t len) {
+	size_t i = 0;
+#if defined(__SSE2__)
+	for (; i + 16 <= len; i += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		unsigned equal = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+		if (equal != 0xFFFF) {
+			return i + __builtin_ctz(~equal);
+		}
+	}
+#endif
+	for (; i < len; ++i) {
+		if (a[i] != b[i]) { return i; }
+	}
+	return len;
+}
+
+// number of newlines in data[0, len)
+size_t count_lines(const char *data, size_t len) {
+	size_t lines = 0;
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i newline = _mm_set1_epi8('\n');
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+		lines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+	}
+#endif
+	for (; i < len; ++i) {
+		lines += data[i] == '\n';
+	}
+	return lines;
+}
+
+// lines in data[0, len), a last line without a newline counts too
+size_t total_lines(const char *data, size_t len) {
+	return count_lines(data, len) + (len > 0 && data[len - 1] != '\n');
+}
+
+// offset of the line after the first lines lines, size if there are fewer
+size_t skip_lines(const char *data, size_t size, uint64_t lines) {
+	size_t offset = 0;
+	for (uint64_t i = 0; i < lines && offset < size; ++i) {
+		const void *nl = std::memchr(data + offset, '\n', size - offset);
+		offset = nl ? static_cast<const char *>(nl) - data + 1 : size;
+	}
+	return offset;
+}
+
+// the line containing offset plus up to before/after lines around it
+struct Context {
+	std::vector<std::string> before;
+	std::string line;
+	std::vector<std::string> after;
+};
+
+Context text_context(const char *data, size_t size, size_t offset, int before, int after) {
+	auto line_start = [&](size_t pos) {
+		while (pos > 0 && data[pos - 1] != '\n') { --pos; }
+		return pos;
+	};
+	auto line_end = [&](size_t pos) {
+		const void *nl = std::memchr(data + pos, '\n', size - pos);
+		return nl ? static_cast<const char *>(nl) - data : size;
+	};
+
+	Context context;
+	size_t start = line_start(offset);
+	size_t end = line_end(start);
+	context.line.assign(data + start, end - start);
+
+	size_t pos = start;
+	for (int i = 0; i < before && pos > 0; ++i) {
+		size_t prev = line_start(pos - 1);
+		context.before.insert(context.before.begin(), std::string(data + prev, pos - 1 - prev));
+		pos = prev;
+	}
+	pos = end;
+	for (int i = 0; i < after && pos + 1 < size; ++i) {
+		size_t next_end = line_end(pos + 1);
+		context.after.emplace_back(data + pos + 1, next_end - pos - 1);
+		pos = next_end;
+	}
+	return context;
+}
+
+Context trace_context(const TraceReader &trace, size_t index, int before, int after) {
+	auto line = [&](size_t i) {
+		char text[DOCTOR_LINE_LENGTH];
+		return std::string(text, format_doctor_line(trace[i], text));
+	};
+
+	Context context;
+	for (size_t i = index > static_cast<size_t>(before) ? index - before : 0; i < index; ++i) {
+		context.before.push_back(line(i));
+	}
+	if (index < trace.size()) {
+		context.line = line(index);
+	}
+	for (size_t i = index + 1; i < trace.size() && i <= index + after; ++i) {
+		context.after.push_back(line(i));
+	}
+	return context;
+}
+
+void print_divergence(size_t line, const Context &ours, const Context &reference) {
+	std::printf("first difference at line %zu\n", line + 1);
+	size_t first = line - ours.before.size();
+	for (size_t i = 0; i < ours.before.size(); ++i) {
+		std::printf("  %10zu  %s\n", first + i + 1, ours.before[i].c_str());
+	}
+	std::printf("< %10zu  %s\n", line + 1, ours.line.c_str());
+	std::printf("> %10zu  %s\n", line + 1, reference.line.c_str());
+	// mark the columns that differ
+	std::string marks(ours.line.size() > reference.line.size() ? ours.line.size() : reference.line.size(), ' ');
+	for (size_t i = 0; i < marks.size(); ++i) {
+		bool same = i < ours.line.size() && i < reference.line.size() && ours.line[i] == reference.line[i];
+		if (!same) { marks[i] = '^'; }
+	}
+	std::printf("  %10s  %s\n", "", marks.c_str());
+	for (size_t i = 0; i < ours.after.size(); ++i) {
+		std::printf("< %10zu  %s\n", line + i + 2, ours.after[i].c_str());
+	}
+	for (size_t i = 0; i < reference.after.size(); ++i) {
+		std::printf("> %10zu  %s\n", line + i + 2, reference.after[i].c_str());
+	}
+}
+
+}
+
+int main(int argc, char **argv) {
+	std::vector<std::string> files;
+	int context_lines = 5;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg{argv[i]};
+		if (arg == "--context" && i + 1 < argc) {
+			context_lines = std::stoi(argv[++i]);
+		} else {
+			files.push_back(arg);
+		}
+	}
+	if (files.size() != 2) {
+		std::fprintf(stderr, "usage: %s <trace|log> <reference log> [--context N]\n", argv[0]);
+		return 2;
+	}
+
+	MappedFile reference;
+	if (!reference.open(files[1])) {
+		std::fprintf(stderr, "can't read %s\n", files[1].c_str());
+		return 2;
+	}
+	const char *ref = reference.data();
+	size_t ref_size = reference.size();
+
+	TraceReader trace;
+	if (trace.open(files[0])) {
+		// the ring wrapped, its first record lines up with a later log line
+		uint64_t dropped = trace.dropped();
+		size_t offset = skip_lines(ref, ref_size, dropped);
+		if (dropped > 0) {
+			std::printf("trace wrapped, %llu records lost, comparing from line %llu\n",
+				static_cast<unsigned long long>(dropped), static_cast<unsigned long long>(dropped + 1));
+		}
+
+		// format each record and compare it against the next reference line,
+		// which ends in a newline or at the end of the file
+		char text[DOCTOR_LINE_LENGTH];
+		for (size_t i = 0; i < trace.size(); ++i) {
+			if (offset == ref_size) {
+				std::printf("reference ends after %zu lines, the trace continues\n", static_cast<size_t>(dropped + i));
+				return 1;
+			}
+			size_t len = format_doctor_line(trace[i], text);
+			size_t available = ref_size - offset < len ? ref_size - offset : len;
+			size_t mismatch = first_mismatch(text, ref + offset, available);
+			size_t end = offset + len;
+			bool line_ends = end == ref_size || (end < ref_size && ref[end] == '\n');
+			if (mismatch < len || !line_ends) {
+				print_divergence(dropped + i, trace_context(trace, i, context_lines, context_lines),
+					text_context(ref, ref_size, offset, context_lines, context_lines));
+				return 1;
+			}
+			offset = end < ref_size ? end + 1 : end;
+		}
+		if (offset < ref_size) {
+			std::printf("trace ends after %zu lines, the reference continues\n", static_cast<size_t>(dropped + trace.size()));
+			return 1;
+		}
+		std::printf("%zu lines match\n", trace.size());
+		if (dropped > 0) {
+			std::printf("lines 1 to %llu weren't compared\n", static_cast<unsigned long long>(dropped));
+		}
+		return 0;
+	}
+
+	MappedFile ours;
+	if (!ours.open(files[0])) {
+		std::fprintf(stderr, "can't read %s\n", files[0].c_str());
+		return 2;
+	}
+	size_t common = ours.size() < ref_size ? ours.size() : ref_size;
+	size_t mismatch = first_mismatch(ours.data(), ref, common);
+	// the longer file may only add the last line's newline
+	const char *longer = ours.size() < ref_size ? ref : ours.data();
+	size_t longer_size = ours.size() < ref_size ? ref_size : ours.size();
+	bool only_newline = longer_size == common + 1 && longer[common] == '\n';
+	if (mismatch == common && (ours.size() == ref_size || only_newline)) {
+		std::printf("%zu lines match\n", total_lines(ref, common));
+		return 0;
+	}
+	if (mismatch == common) {
+		std::printf("%s ends after %zu lines, the other file continues\n",
+			(ours.size() < ref_size ? files[0] : files[1]).c_str(), total_lines(ref, common));
+		return 1;
+	}
+	size_t line = count_lines(ref, mismatch);
+	print_divergence(line, text_context(ours.data(), ours.size(), mismatch, context_lines, context_lines),
+		text_context(ref, ref_size, mismatch, context_lines, context_lines));
+	return 1;
+}